@@ -140,7 +140,7 @@ void Board::loadFEN(const string &fen, bool isWhite, bool whiteCanCastleKingSide
     this->removeCastlingRightsWK = -1;
     this->removeCastlingRightsWQ = -1;
 
-    enPassantSquare = enPassantSquare;
+    this->enPassantSquare = enPassantSquare;
     setupBitboards();
     attackedBB[sideToMove] = getAttackedBB(sideToMove);
     attackedBB[otherSide] = getAttackedBB(otherSide);
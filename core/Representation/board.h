@@ -152,6 +152,9 @@ private:
     unsigned long long seed;
 
 public:
+    // Fixed seed, the Zobrist keys and with them the search must be the same on every run
+    RNG(unsigned long long seed = 0x2545F4914F6CDD1DULL) : seed(seed) {}
+
     unsigned long long rand64()
     {
         seed += seed/2 + 78651276235ULL;
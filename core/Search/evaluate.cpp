@@ -35,9 +35,9 @@ int allPieces(Board* board)
     return score;
 }
 
-float evaluate(Board* board)
+Score evaluate(Board* board)
 {
-    float score = 0;
+    Score score = 0;
 
     // Piece Tables
     score += allPieces(board);
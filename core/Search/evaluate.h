@@ -1,11 +1,12 @@
 #ifndef EVALUATE_H
 #define EVALUATE_H
 
+#include "score.h"
 #include "../representation/board.h"
 
 constexpr int pieceValues[7] = { 0, 100, 300, 320, 500, 900, 100000 };
 
-extern float evaluate(Board* board);
+extern Score evaluate(Board* board);
 
 
 #endif
\ No newline at end of file
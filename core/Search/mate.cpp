@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "mate.h"
+#include "search.h"
+#include "../uci.h"
+#include "../movegen/movegen.h"
+
+using namespace std;
+
+// clang-format off
+#define PN_INFINITY      1000000000u // Proof or disproof number of a solved position
+#define MATE_TABLE_SIZE  (1 << 20)   // Entries of 16 bytes, allocated on first use
+#define MATE_POLL_NODES  4096        // Nodes between checks of the stop flag and limits
+// clang-format on
+
+// The proof number is how many more positions must be proven before the root is mate,
+// the disproof number how many must be refuted before it isn't. Both are counted for the
+// attacker, 0 proof means mate and 0 disproof means no mate in the plies that were left.
+struct MateEntry
+{
+    uint64_t key;
+    uint32_t pn;
+    uint32_t dn;
+};
+
+vector<MateEntry> mateTable;
+uint64_t mateNodes;
+unsigned int mateNodeLimit;
+bool mateAborted;
+
+struct MateChild
+{
+    Move move;
+    uint64_t key;
+};
+
+void clearMateTable()
+{
+    fill(mateTable.begin(), mateTable.end(), MateEntry{});
+}
+
+// The plies left are part of the key, a position can be mate in 3 but not mate in 2
+uint64_t mateKey(Board *board, int pliesLeft)
+{
+    return board->zobristKey ^ (0x9E3779B97F4A7C15ULL * (uint64_t)(pliesLeft + 1));
+}
+
+// Positions not in the table count as a single unexplored leaf
+void lookupNumbers(uint64_t key, uint32_t &pn, uint32_t &dn)
+{
+    const MateEntry &entry = mateTable[key & (MATE_TABLE_SIZE - 1)];
+    if (entry.key == key)
+    {
+        pn = entry.pn;
+        dn = entry.dn;
+    }
+    else
+    {
+        pn = dn = 1;
+    }
+}
+
+void storeNumbers(uint64_t key, uint32_t pn, uint32_t dn)
+{
+    MateEntry &entry = mateTable[key & (MATE_TABLE_SIZE - 1)];
+    entry.key = key;
+    entry.pn = pn;
+    entry.dn = dn;
+}
+
+void pollMateLimits()
+{
+    if (stopSearch || (mateNodeLimit && mateNodes >= mateNodeLimit) ||
+        (timeManager.isTimeLimited() && timeManager.elapsed() >= timeManager.getHardLimit()))
+    {
+        mateAborted = true;
+    }
+}
+
+// Depth-first proof-number search, keeps expanding the most proving child below this node
+// until its proof or disproof number reaches the threshold the parent gave it
+void mateSearch(Board *board, int pliesLeft, bool attacker, uint32_t thresholdPn, uint32_t thresholdDn)
+{
+    uint64_t key = mateKey(board, pliesLeft);
+    if (++mateNodes % MATE_POLL_NODES == 0)
+    {
+        pollMateLimits();
+    }
+    if (mateAborted)
+    {
+        return;
+    }
+
+    MoveList moveList;
+    generateMoves(board, moveList);
+
+    // Only the defender can be mated, running out of plies or stalemate refutes the mate
+    if (moveList.count == 0 || pliesLeft == 0)
+    {
+        bool mated = moveList.count == 0 && !attacker && board->inCheck;
+        storeNumbers(key, mated ? 0 : PN_INFINITY, mated ? PN_INFINITY : 0);
+        return;
+    }
+
+    // Forcing moves first, the defender's moves are all evasions when in check.
+    // With one ply left only a check can mate, so the attacker's quiet moves are dropped.
+    MateChild children[256];
+    MateChild others[256];
+    int count = 0;
+    int otherCount = 0;
+    for (int i = 0; i < moveList.count; i++)
+    {
+        Move move = moveList.moves[i];
+        board->makeMove(move);
+        bool givesCheck = board->inCheck;
+        MateChild child = {move, mateKey(board, pliesLeft - 1)};
+        board->undoMove();
+
+        if (givesCheck || (!attacker && isCapture(move)))
+        {
+            children[count++] = child;
+        }
+        else if (!attacker || pliesLeft > 1)
+        {
+            others[otherCount++] = child;
+        }
+    }
+    for (int i = 0; i < otherCount; i++)
+    {
+        children[count++] = others[i];
+    }
+
+    if (count == 0)
+    {
+        storeNumbers(key, PN_INFINITY, 0);
+        return;
+    }
+
+    // The attacker needs one proven child so its proof number is the smallest of the children
+    // and its disproof number their sum, the defender the other way round
+    while (true)
+    {
+        uint64_t summed = 0;
+        uint32_t best = PN_INFINITY;
+        uint32_t second = PN_INFINITY;
+        uint32_t bestSummed = 0;
+        int bestIndex = 0;
+        for (int i = 0; i < count; i++)
+        {
+            uint32_t pn, dn;
+            lookupNumbers(children[i].key, pn, dn);
+            uint32_t minimized = attacker ? pn : dn;
+            uint32_t added = attacker ? dn : pn;
+
+            summed += added;
+            if (minimized < best)
+            {
+                second = best;
+                best = minimized;
+                bestSummed = added;
+                bestIndex = i;
+            }
+            else if (minimized < second)
+            {
+                second = minimized;
+            }
+        }
+        uint32_t total = (uint32_t)min(summed, (uint64_t)PN_INFINITY);
+
+        uint32_t pn = attacker ? best : total;
+        uint32_t dn = attacker ? total : best;
+        if (pn >= thresholdPn || dn >= thresholdDn || mateAborted)
+        {
+            storeNumbers(key, pn, dn);
+            return;
+        }
+
+        // The best child may go on until it stops being better than the second best,
+        // and use whatever room its siblings leave of the other threshold
+        uint32_t thresholdMin = attacker ? thresholdPn : thresholdDn;
+        uint32_t thresholdSum = attacker ? thresholdDn : thresholdPn;
+        uint32_t secondBound = second == PN_INFINITY ? PN_INFINITY : second + 1;
+        uint32_t childMin = thresholdMin < secondBound ? thresholdMin : secondBound;
+        uint32_t childSum = (uint32_t)min((uint64_t)thresholdSum - total + bestSummed, (uint64_t)PN_INFINITY);
+
+        board->makeMove(children[bestIndex].move);
+        mateSearch(board, pliesLeft - 1, !attacker, attacker ? childMin : childSum, attacker ? childSum : childMin);
+        board->undoMove();
+    }
+}
+
+bool isProven(Board *board, int pliesLeft)
+{
+    uint32_t pn, dn;
+    lookupNumbers(mateKey(board, pliesLeft), pn, dn);
+    return pn == 0;
+}
+
+// Follows proven moves from the root, positions that were overwritten in the table get proven again.
+// The attacker takes the first proven move, the defender the one the table says holds out longest.
+void mateLine(Board board, int pliesLeft, MoveStack &line)
+{
+    bool attacker = true;
+    line.count = 0;
+    while (pliesLeft > 0)
+    {
+        MoveList moveList;
+        generateMoves(&board, moveList);
+
+        Move next = 0;
+        int nextLength = 0;
+        for (int pass = 0; pass < 2 && !next; pass++)
+        {
+            for (int i = 0; i < moveList.count && !(attacker && next); i++)
+            {
+                board.makeMove(moveList.moves[i]);
+                if (pass == 1)
+                {
+                    mateSearch(&board, pliesLeft - 1, !attacker, PN_INFINITY, PN_INFINITY);
+                }
+                int length = -1;
+                if (isProven(&board, pliesLeft - 1))
+                {
+                    length = pliesLeft - 1;
+                    while (!attacker && length >= 3 && isProven(&board, length - 2))
+                    {
+                        length -= 2;
+                    }
+                }
+                board.undoMove();
+
+                if (length >= 0 && (!next || length > nextLength))
+                {
+                    next = moveList.moves[i];
+                    nextLength = length;
+                }
+            }
+        }
+        if (!next)
+        {
+            return;
+        }
+
+        line += next;
+        board.makeMove(next);
+        pliesLeft--;
+        attacker = !attacker;
+    }
+}
+
+Move solveMate(Board *board, const SearchLimits &limits, Move &ponderMove)
+{
+    if (mateTable.empty())
+    {
+        mateTable.resize(MATE_TABLE_SIZE);
+    }
+
+    timeManager.start(limits, board->isWhite);
+    mateNodes = 0;
+    mateNodeLimit = limits.nodes;
+    mateAborted = false;
+    ponderMove = 0;
+
+    // Mate in 1 first and one more move each time, so the first mate proven is the shortest
+    for (unsigned int moves = 1; moves <= limits.mate; moves++)
+    {
+        int plies = 2 * moves - 1;
+        mateSearch(board, plies, true, PN_INFINITY, PN_INFINITY);
+        if (mateAborted)
+        {
+            break;
+        }
+
+        uint32_t pn, dn;
+        lookupNumbers(mateKey(board, plies), pn, dn);
+        int time = timeManager.elapsed();
+        if (pn == 0)
+        {
+            MoveStack line;
+            mateLine(*board, plies, line);
+            ponderMove = line.count > 1 ? line.moves[1] : 0;
+
+            ostringstream info;
+            info << "info depth " << plies
+                 << " score mate " << moves
+                 << " nodes "      << mateNodes
+                 << " nps "        << (unsigned long long)(mateNodes * 1000 / (time + 1))
+                 << " time "       << time
+                 << " pv "         << line;
+            sendLine(info.str());
+            return line.count ? line.moves[0] : 0;
+        }
+
+        sendLine("info string no mate in " + to_string(moves) + " nodes " + to_string(mateNodes) + " time " +
+                 to_string(time));
+    }
+
+    int time = timeManager.elapsed();
+    ostringstream info;
+    info << "info string " << (mateAborted ? "mate search stopped" : "no mate found")
+         << " within " << limits.mate << " moves, nodes " << mateNodes
+         << " nps " << (unsigned long long)(mateNodes * 1000 / (time + 1))
+         << " time " << time;
+    sendLine(info.str());
+    return 0;
+}
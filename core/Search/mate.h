@@ -0,0 +1,14 @@
+#ifndef MATE_H
+#define MATE_H
+
+#include "../representation/board.h"
+#include "../representation/move.h"
+#include "timeman.h"
+
+// Mate solver for "go mate N", a depth-first proof-number search separate from the alpha-beta search.
+// Returns the first move of the shortest mate within limits.mate moves and its expected reply, or 0 if
+// no mate was proven.
+extern Move solveMate(Board *board, const SearchLimits &limits, Move &ponderMove);
+extern void clearMateTable();
+
+#endif
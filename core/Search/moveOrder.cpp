@@ -1,5 +1,24 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "evaluate.h"
 #include "moveOrder.h"
 
+// Most valuable victim, least valuable attacker, by [victim type][attacker type]
+// clang-format off
+constexpr int mvvLva[7][7] = {
+    {0,   0,   0,   0,   0,   0,   0}, // Empty
+    {0, 105, 104, 103, 102, 101, 100}, // Pawn
+    {0, 205, 204, 203, 202, 201, 200}, // Knight
+    {0, 305, 304, 303, 302, 301, 300}, // Bishop
+    {0, 405, 404, 403, 402, 401, 400}, // Rook
+    {0, 505, 504, 503, 502, 501, 500}, // Queen
+    {0,   0,   0,   0,   0,   0,   0}, // King
+};
+// clang-format on
+
+#define CAPTURE_HISTORY_DIV 256 // HISTORY_MAX / 256 = 64, history only reorders captures of the same victim
+
 struct MoveScore
 {
     Move move;
@@ -36,7 +55,141 @@ void quickSort(MoveScore *moveScores, int left, int right)
         quickSort(moveScores, i, right);
 }
 
-void sortMoves(MoveList *moveList, Move prevMove, Board *board, bool onlyCaptures)
+void clearHistory(MoveHistory *history)
+{
+    memset(history->butterfly, 0, sizeof(history->butterfly));
+    memset(history->counterMoves, 0, sizeof(history->counterMoves));
+    memset(history->continuation, 0, sizeof(history->continuation));
+    memset(history->captures, 0, sizeof(history->captures));
+}
+
+// Keeps what was learned in the previous search but lets the new one take over quickly
+void ageHistory(MoveHistory *history)
+{
+    for (auto &color : history->butterfly)
+    {
+        for (auto &from : color)
+        {
+            for (int &entry : from)
+            {
+                entry /= 2;
+            }
+        }
+    }
+    for (auto &piece : history->captures)
+    {
+        for (auto &to : piece)
+        {
+            for (int &entry : to)
+            {
+                entry /= 2;
+            }
+        }
+    }
+    for (auto &piece : history->continuation)
+    {
+        for (auto &to : piece)
+        {
+            for (auto &nextPiece : to)
+            {
+                for (int16_t &entry : nextPiece)
+                {
+                    entry /= 2;
+                }
+            }
+        }
+    }
+}
+
+// Gravity update, the closer an entry is to HISTORY_MAX the less a bonus moves it
+template <typename T>
+void updateEntry(T &entry, int bonus)
+{
+    entry += bonus - entry * abs(bonus) / HISTORY_MAX;
+}
+
+int historyBonus(int depth)
+{
+    int bonus = 32 * depth * depth;
+    return bonus < 1600 ? bonus : 1600;
+}
+
+void updateQuietEntries(MoveHistory *history, PieceToHistory **continuation, Board *board, Move move, int bonus)
+{
+    int color = board->isWhite ? 0 : 1;
+    Piece piece = board->board[getFrom(move)];
+
+    updateEntry(history->butterfly[color][getFrom(move)][getTo(move)], bonus);
+    for (int i = 0; i < 2; i++)
+    {
+        if (continuation[i])
+        {
+            updateEntry((*continuation[i])[piece][getTo(move)], bonus);
+        }
+    }
+}
+
+// Called on a beta cutoff by a quiet move, the quiet moves searched before it get a malus.
+// continuation holds the tables for the moves one and two plies ago, either can be null
+void updateQuietHistory(MoveHistory *history, PieceToHistory **continuation, Board *board, Move bestMove,
+                        const Move *quiets, int quietCount, int depth)
+{
+    int bonus = historyBonus(depth);
+
+    updateQuietEntries(history, continuation, board, bestMove, bonus);
+    for (int i = 0; i < quietCount; i++)
+    {
+        if (quiets[i] != bestMove)
+        {
+            updateQuietEntries(history, continuation, board, quiets[i], -bonus);
+        }
+    }
+}
+
+int &captureEntry(MoveHistory *history, Board *board, Move move)
+{
+    return history->captures[board->board[getFrom(move)]][getTo(move)][Pieces::getType(getCapturedPiece(move))];
+}
+
+// Called on every beta cutoff, captures searched before the cutoff move get a malus
+void updateCaptureHistory(MoveHistory *history, Board *board, Move bestMove, const Move *captures, int captureCount, int depth)
+{
+    int bonus = historyBonus(depth);
+
+    if (isCapture(bestMove))
+    {
+        updateEntry(captureEntry(history, board, bestMove), bonus);
+    }
+    for (int i = 0; i < captureCount; i++)
+    {
+        if (captures[i] != bestMove)
+        {
+            updateEntry(captureEntry(history, board, captures[i]), -bonus);
+        }
+    }
+}
+
+int getCaptureHistory(const MoveHistory *history, Board *board, Move move)
+{
+    return history->captures[board->board[getFrom(move)]][getTo(move)][Pieces::getType(getCapturedPiece(move))];
+}
+
+int getQuietHistory(const OrderingContext *ordering, Board *board, Move move)
+{
+    Piece piece = board->board[getFrom(move)];
+    int score = ordering->history->butterfly[board->isWhite ? 0 : 1][getFrom(move)][getTo(move)];
+    for (int i = 0; i < 2; i++)
+    {
+        if (ordering->continuation[i])
+        {
+            score += (*ordering->continuation[i])[piece][getTo(move)];
+        }
+    }
+    return score;
+}
+
+void sortMoves(MoveList *moveList, Move prevMove, Board *board, bool onlyCaptures,
+               const OrderingContext *ordering)
 {
     MoveScore moveScores[256];
     int moveCount = moveList->count;
@@ -57,12 +210,36 @@ void sortMoves(MoveList *moveList, Move prevMove, Board *board, bool onlyCapture
         }
         if (isCapture(moveScores[i].move))
         {
-            moveScores[i].score += (100000 + (Pieces::getType(getCapturedPiece(moveScores[i].move)) - Pieces::getType(board->board[from])));
+            moveScores[i].score += 100000 + mvvLva[Pieces::getType(getCapturedPiece(moveScores[i].move))][Pieces::getType(board->board[from])];
+            if (ordering)
+            {
+                moveScores[i].score += getCaptureHistory(ordering->history, board, moveScores[i].move) / CAPTURE_HISTORY_DIV;
+            }
         }
         if (isPromotion(moveScores[i].move))
         {
             moveScores[i].score += 200000;
         }
+        if (ordering && ordering->killers && !isCapture(moveScores[i].move) && !isPromotion(moveScores[i].move))
+        {
+            // Killers and the countermove go right after the captures, the other quiet moves are ordered by history
+            if (moveScores[i].move == ordering->killers[0])
+            {
+                moveScores[i].score += 90000;
+            }
+            else if (moveScores[i].move == ordering->killers[1])
+            {
+                moveScores[i].score += 80000;
+            }
+            else if (moveScores[i].move == ordering->counterMove)
+            {
+                moveScores[i].score += 70000;
+            }
+            else
+            {
+                moveScores[i].score += getQuietHistory(ordering, board, moveScores[i].move);
+            }
+        }
         if (Pieces::getType(board->board[from]) == Pieces::King)
         {
             moveScores[i].score -= 10;
@@ -79,4 +256,106 @@ void sortMoves(MoveList *moveList, Move prevMove, Board *board, bool onlyCapture
     {
         moveList->moves[i] = moveScores[i].move;
     }
-}
\ No newline at end of file
+}
+
+// Squares a pawn of this color attacks from the given squares
+Bitboard pawnAttacks(Bitboard pawns, Pieces::Color side)
+{
+    Bitboard notH = pawns & ~fileMasks[7];
+    Bitboard notA = pawns & ~fileMasks[0];
+    if (side == Pieces::White)
+    {
+        return shift(&notH, SE, 1) | shift(&notA, SW, 1);
+    }
+    return shift(&notH, NE, 1) | shift(&notA, NW, 1);
+}
+
+// Pieces of both colors attacking the square, sliders looking through whatever is not in occupied
+Bitboard attackersTo(Board *board, int square, Bitboard occupied)
+{
+    Bitboard squareBB = getBitboardFromSquare(square);
+    Bitboard diagonal = board->pieceBB[Pieces::Bishop] | board->pieceBB[Pieces::Queen];
+    Bitboard straight = board->pieceBB[Pieces::Rook] | board->pieceBB[Pieces::Queen];
+
+    return (pawnAttacks(squareBB, Pieces::Black) & board->pieceBB[Pieces::Pawn] & board->colorBB[Pieces::White]) |
+           (pawnAttacks(squareBB, Pieces::White) & board->pieceBB[Pieces::Pawn] & board->colorBB[Pieces::Black]) |
+           (getAttackBB<Pieces::Knight>(square) & board->pieceBB[Pieces::Knight]) |
+           (getAttackBB<Pieces::Bishop>(square, &occupied) & diagonal) |
+           (getAttackBB<Pieces::Rook>(square, &occupied) & straight) |
+           (getAttackBB<Pieces::King>(square) & board->pieceBB[Pieces::King]);
+}
+
+// Static exchange evaluation, true if trading pieces on the target square starting with move
+// wins at least threshold for the side making it. Both sides always recapture with their least
+// valuable piece and may stop when they are ahead. Castling, promotions and en passant count as even.
+bool seeAtLeast(Board *board, Move move, int threshold)
+{
+    int from = getFrom(move);
+    int to = getTo(move);
+    if (isCastle(move) || isPromotion(move) || (isCapture(move) && board->board[to] == Pieces::Empty))
+    {
+        return threshold <= 0;
+    }
+
+    int swap = pieceValues[Pieces::getType(board->board[to])] - threshold;
+    if (swap < 0)
+    {
+        return false;
+    }
+    swap = pieceValues[Pieces::getType(board->board[from])] - swap;
+    if (swap <= 0)
+    {
+        return true;
+    }
+
+    Bitboard occupied = board->allPiecesBB ^ getBitboardFromSquare(from) ^ getBitboardFromSquare(to);
+    Bitboard attackers = attackersTo(board, to, occupied);
+    Bitboard diagonal = board->pieceBB[Pieces::Bishop] | board->pieceBB[Pieces::Queen];
+    Bitboard straight = board->pieceBB[Pieces::Rook] | board->pieceBB[Pieces::Queen];
+    Pieces::Color side = Pieces::getColor(board->board[from]);
+    int result = 1;
+
+    while (true)
+    {
+        side = ~side;
+        attackers &= occupied;
+        Bitboard sideAttackers = attackers & board->colorBB[side];
+        if (!sideAttackers)
+        {
+            break;
+        }
+        result ^= 1;
+
+        int type = Pieces::Pawn;
+        while (!(sideAttackers & board->pieceBB[type]))
+        {
+            type++;
+        }
+
+        // The king can only take last, if the other side still attacks the square it can't
+        if (type == Pieces::King)
+        {
+            return (attackers & board->colorBB[~side]) ? result ^ 1 : result;
+        }
+
+        swap = pieceValues[type] - swap;
+        if (swap < result)
+        {
+            break;
+        }
+
+        Bitboard attacker = sideAttackers & board->pieceBB[type];
+        occupied ^= attacker & -attacker;
+
+        // Sliders behind the piece that just took join in
+        if (type == Pieces::Pawn || type == Pieces::Bishop || type == Pieces::Queen)
+        {
+            attackers |= getAttackBB<Pieces::Bishop>(to, &occupied) & diagonal;
+        }
+        if (type == Pieces::Rook || type == Pieces::Queen)
+        {
+            attackers |= getAttackBB<Pieces::Rook>(to, &occupied) & straight;
+        }
+    }
+    return result;
+}
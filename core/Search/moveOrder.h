@@ -4,6 +4,39 @@
 #include "../representation/board.h"
 #include "../movegen/movegen.h"
 
-extern void sortMoves(MoveList *moves, Move prevMove, Board *board, bool onlyCaptures = false);
+#define HISTORY_MAX 16384 // History scores stay within +-HISTORY_MAX
+
+// History indexed by [piece][to] of a move, piece includes the color
+typedef int16_t PieceToHistory[16][64];
+
+// What move ordering has learned during the search, each search thread owns one
+struct MoveHistory
+{
+    int butterfly[2][64][64];               // [color][from][to], how often the move caused a beta cutoff
+    Move counterMoves[16][64];              // [piece][to] of the previous move, the reply that refuted it
+    PieceToHistory continuation[16][64];    // [piece][to] of an earlier move, then [piece][to] of this one
+    int captures[16][64][7];                // [piece][to][captured type], how often the capture caused a beta cutoff
+};
+
+// Everything known about the current node that helps with ordering its moves
+struct OrderingContext
+{
+    const MoveHistory *history;
+    const Move *killers;                    // The two killer moves for this ply, null in qsearch
+    Move counterMove;                       // Refutation of the previous move, 0 if there is none
+    const PieceToHistory *continuation[2];  // For the moves one and two plies ago, null if there is no such move
+};
+
+extern void clearHistory(MoveHistory *history);
+extern void ageHistory(MoveHistory *history);
+extern void updateQuietHistory(MoveHistory *history, PieceToHistory **continuation, Board *board, Move bestMove,
+                               const Move *quiets, int quietCount, int depth);
+extern void updateCaptureHistory(MoveHistory *history, Board *board, Move bestMove, const Move *captures, int captureCount, int depth);
+extern int getQuietHistory(const OrderingContext *ordering, Board *board, Move move);
+extern int getCaptureHistory(const MoveHistory *history, Board *board, Move move);
+extern bool seeAtLeast(Board *board, Move move, int threshold);
+
+extern void sortMoves(MoveList *moves, Move prevMove, Board *board, bool onlyCaptures = false,
+                      const OrderingContext *ordering = nullptr);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef SCORE_H
+#define SCORE_H
+
+// Scores are centipawns from the side to move's point of view.
+// Being mated in n plies from the root is NEGINF + n, mating is POSINF - n.
+typedef int Score;
+
+// clang-format off
+#define POSINF           1000000
+#define NEGINF          -1000000
+#define MATE_BOUND       (POSINF - 256) // Anything further from zero is a mate score
+// clang-format on
+
+inline bool IsMate(Score score) { return score > MATE_BOUND || score < -MATE_BOUND; }
+
+// Mate scores are stored relative to the node instead of the root, so a table entry
+// is still right when the position is reached at a different ply
+inline Score scoreToTT(Score score, int ply)
+{
+    return score > MATE_BOUND ? score + ply : score < -MATE_BOUND ? score - ply : score;
+}
+
+inline Score scoreFromTT(Score score, int ply)
+{
+    return score > MATE_BOUND ? score - ply : score < -MATE_BOUND ? score + ply : score;
+}
+
+#endif
@@ -1,9 +1,14 @@
 #include <cassert>
+#include <atomic>
 #include <chrono>
+#include <algorithm>
+#include <thread>
+#include <vector>
 
 #include "evaluate.h"
 #include "moveOrder.h"
 #include "search.h"
+#include "treeDump.h"
 #include "../uci.h"
 #include "../movegen/movegen.h"
 #include "../representation/board.h"
@@ -12,19 +17,50 @@
 using namespace std;
 
 // clang-format off
-#define POSINF           1000000
-#define NEGINF          -1000000
 #define FUTILITY_MARGIN  200
 #define RAZORING_MARGIN  500
+#define ASPIRATION_DEPTH 4   // First depth searched with an aspiration window
+#define ASPIRATION_DELTA 25  // Initial half width of the aspiration window
+#define LMR_MIN_DEPTH    3   // Shallowest depth at which late moves get reduced
+#define LMR_MIN_MOVES    3   // Moves searched at full depth before reductions start
+#define LMR_HISTORY_DIV  8192  // History score worth one ply of reduction
+#define SINGULAR_DEPTH   6   // Shallowest depth at which the TT move is tested for singularity
+#define SINGULAR_MARGIN  2   // Margin below the TT score per ply of depth
+#define IIR_DEPTH        4   // Shallowest depth reduced when there is no TT move
+#define DELTA_MARGIN     200 // Positional swing allowed for on top of a capture in qsearch
+#define PROBCUT_DEPTH    5   // Shallowest depth ProbCut is tried at
+#define PROBCUT_REDUCTION 4  // Plies less for the verification search
+#define LMP_DEPTH        8   // Deepest depth late move pruning is done at
+#define LMP_BASE         3   // Quiet moves tried at any depth before the rest get pruned
+#define HISTORY_PRUNING_DEPTH  3    // Deepest depth quiets are pruned by history
+#define HISTORY_PRUNING_MARGIN 4000 // History below -margin * depth gets pruned
+#define SEE_QUIET_DEPTH  8   // Deepest depth quiets that hang material are pruned
+#define SEE_QUIET_MARGIN 80  // Material a quiet move may lose per ply of depth
+#define INFO_INTERVAL    1000 // Milliseconds between progress reports within an iteration
+#define DEFAULT_HASH_MB  16  // Transposition table size until "setoption name Hash"
 // clang-format on
 
-unsigned long long startTime;
-float maxTimeMS = 0;
-bool stopSearch = false;
+// Late move reductions by [depth][moveNumber], filled in by initSearch()
+int lmrReductions[MAX_DEPTH + 1][64];
 
-TranspositionTable *tt = new TranspositionTable(pow(2, 20));
+void initSearch()
+{
+    for (int depth = 1; depth <= MAX_DEPTH; depth++)
+    {
+        for (int moveNumber = 1; moveNumber < 64; moveNumber++)
+        {
+            lmrReductions[depth][moveNumber] = (int)(0.5 + log(depth) * log(moveNumber) / 2.25);
+        }
+    }
+}
+
+atomic<bool> stopSearch(false);
+atomic<bool> ponderSearch(false);
+atomic<bool> infiniteSearch(false);
+
+TranspositionTable *tt = new TranspositionTable(DEFAULT_HASH_MB * 1024 * 1024);
+int hashSize = DEFAULT_HASH_MB;
 
-void clearTTSearch() { tt->clear(); }
 
 int futilityMargin(int depth)
 {
@@ -35,98 +71,496 @@ ostream &operator<<(ostream &os, const MoveStack &moveVal)
 {
     for (int i = 0; i < moveVal.count; i++)
     {
-        os << moveToString(moveVal.moves[i]) << " ";
+        os << (i ? " " : "") << moveToString(moveVal.moves[i]);
     }
     return os;
 }
 
-// Update the path of the stack with the move and the child stack
-void update_path(MoveStack *stack, Move move, const MoveStack *childStack)
-{
-    stack->moves[0] = move;
-    for (int i = 0; i < childStack->count; i++)
-    {
-        stack->moves[i + 1] = childStack->moves[i];
-    }
-    stack->count = childStack->count + 1;
-}
-
+// What a search did, kept by each thread for the whole search and summed over all threads
+// when it ends. Printed by printSearchStats() for the "stats" command and with "debug on".
 struct SearchDiagnostics
 {
-    unsigned long long nodes;
+    unsigned long long nodes; // Only filled in the sum, threads count in SearchThread::nodes
     unsigned long long qNodes;
-    unsigned long long time;
-    unsigned long long cutoffs;
-    unsigned int futilityCutoffs;
-    unsigned int razoringCutoffs;
-    unsigned int transpositionCuttoffs;
+    unsigned long long nodesByDepth[MAX_DEPTH + 1]; // By completed iteration, all threads, from the main thread.
+                                                    // Iterations stop at MAX_DEPTH, see startIterativeDeepening()
+    int completedDepth;
+    int time;
+
+    unsigned long long ttProbes;
+    unsigned long long ttHits;
+    unsigned long long ttCutoffs;
+    unsigned long long betaCutoffs;      // Beta cutoffs in the main search
+    unsigned long long firstMoveCutoffs; // Of those, cutoffs caused by the first move searched
+    unsigned long long standPatCutoffs;  // Qsearch nodes cut by the static eval
+
+    // Pruning
+    unsigned long long futilityCutoffs;
+    unsigned long long razoringCutoffs;
+    unsigned long long probCuts;
+    unsigned long long deltaPrunes;    // Captures qsearch skipped as too small to reach alpha
+    unsigned long long seePrunes;      // Captures qsearch skipped as losing the exchange
+    unsigned long long lateMovePrunes; // Quiets skipped for coming too late in the move list
+    unsigned long long historyPrunes;  // Quiets skipped for their bad history
+    unsigned long long seeQuietPrunes; // Quiets skipped for putting a piece where it gets taken
+
+    // Reductions and extensions
+    unsigned long long iirReductions;
+    unsigned long long reducedMoves;      // Moves searched with a late move reduction
+    unsigned long long reducedResearches; // Of those, searched again at full depth
+    unsigned long long checkExtensions;
+    unsigned long long singularExtensions;
+    unsigned long long multiCuts;
 };
 
 struct MoveVal
 {
     Move move;
-    float value;
+    Score value;
+};
+
+// What the search remembers about each ply on the current path
+struct SearchStack
+{
+    Move currentMove;             // Move being searched from this ply
+    Piece movedPiece;             // Piece that made it
+    PieceToHistory *continuation; // Continuation history for that move
+    Move excludedMove;            // Skipped while testing if that move is singular
+    Score staticEval;             // To tell if our position is improving
+    Move killers[2];              // Quiet moves that caused a beta cutoff at this ply
+    Move *pv;                     // Row of the triangular PV table, the best line from this ply on
+    int pvLength;
+};
+
+// A legal move at the root and what the search found out about it
+struct RootMove
+{
+    Move move;
+    Score score;              // From the last search of the move, NEGINF if it only got an upper bound
+    Score previousScore;      // From the previous iteration, centres the aspiration window
+    int depth;                // Iteration the score comes from
+    unsigned long long nodes; // Spent below this move during the whole search
+    MoveStack pv;
+};
+
+// Entries in front of ply 0, so (ss - 1) and (ss - 2) can be read at any ply
+#define STACK_OFFSET 2
+
+// Everything a single search thread owns. With Lazy SMP every helper gets its own
+// board copy, stack and results, only the transposition table is shared.
+struct SearchThread
+{
+    int id;
+    Board board;
+    atomic<unsigned long long> nodes; // Only written by its own thread, read by the main thread while helpers search
+    SearchDiagnostics diagnostics;
+    MoveVal bestMove;
+    Move startMove;
+    int completedDepth;
+    int rootDepth; // Depth of the current iteration, bounds how far extensions can go
+    int selDepth;  // Deepest ply reached in the current iteration, qsearch included
+    vector<RootMove> rootMoves;
+    int pvIndex; // Line being searched, the moves before it are already reported for this iteration
+
+    // Move ordering, learned during the search
+    MoveHistory history;
+
+    // Set up once when the thread is created and reused by every search, each node
+    // overwrites what it needs on entry. Use searchStackAt() to index it by ply.
+    SearchStack searchStack[MAX_DEPTH + 1 + STACK_OFFSET];
+    Move pvTable[MAX_DEPTH + 1][MAX_DEPTH + 1];
+
+    MoveStack pv; // Principal variation of the last completed iteration
+
+    // Limit polling and progress reports, only used by the main thread
+    int pollCountdown;
+    int pollInterval;
+    int lastPollTime;
+    int lastInfoTime;
+    Move currentRootMove;
+    int currentRootMoveNumber;
 };
 
-SearchDiagnostics diagnostics;
-MoveVal bestMove;
-Move startMove;
+inline SearchStack *searchStackAt(SearchThread *thread, int ply)
+{
+    return &thread->searchStack[ply + STACK_OFFSET];
+}
+
+vector<SearchThread *> threads;
+int multiPV = 1; // Lines reported by the main thread, the helpers always search one
+int probCutMargin = PROBCUT_MARGIN; // How far above beta a shallow capture search must land, tunable with setoption
+MoveStack lastPv; // Line behind the last best move returned, gives the ponder move
+SearchDiagnostics lastStats;
+atomic<bool> debugMode(false);
+unsigned long long nodeLimit = 0; // From "go nodes", 0 for no limit
+
+// Helpers skip some iterations so they don't all search the same depth at the same time
+// clang-format off
+constexpr int skipSize[]  = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+constexpr int skipPhase[] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+// clang-format on
+
+void setThreadCount(int count)
+{
+    count = max(count, 1);
+    while ((int)threads.size() > count)
+    {
+        delete threads.back();
+        threads.pop_back();
+    }
+    while ((int)threads.size() < count)
+    {
+        SearchThread *thread = new SearchThread();
+        thread->id = threads.size();
+        for (int ply = -STACK_OFFSET; ply <= MAX_DEPTH; ply++)
+        {
+            // Before the root nothing has been played, and the eval counts as improving
+            SearchStack *ss = searchStackAt(thread, ply);
+            ss->staticEval = NEGINF;
+            ss->pv = ply >= 0 ? thread->pvTable[ply] : nullptr;
+        }
+        threads.push_back(thread);
+    }
+}
+
+int getThreadCount() { return threads.size(); }
+
+void setMultiPV(int lines) { multiPV = max(lines, 1); }
+
+int getMultiPV() { return multiPV; }
+
+void setProbCutMargin(int margin) { probCutMargin = max(margin, 0); }
+
+int getProbCutMargin() { return probCutMargin; }
+
+RootMove *findRootMove(SearchThread *thread, Move move)
+{
+    for (RootMove &rootMove : thread->rootMoves)
+    {
+        if (rootMove.move == move)
+        {
+            return &rootMove;
+        }
+    }
+    return nullptr;
+}
+
+void clearTTSearch() { tt->clear(); }
+
+// Reallocates the transposition table, everything stored in it is lost
+void setHashSize(int megabytes)
+{
+    hashSize = max(megabytes, 1);
+    hashSize = min(hashSize, MAX_HASH_MB); // The table size in bytes is an int
+    delete tt;
+    tt = new TranspositionTable(hashSize * 1024 * 1024);
+}
+
+int getHashSize() { return hashSize; }
+
+void clearKillers(SearchThread *thread)
+{
+    for (int ply = 0; ply <= MAX_DEPTH; ply++)
+    {
+        SearchStack *ss = searchStackAt(thread, ply);
+        ss->killers[0] = ss->killers[1] = 0;
+    }
+}
+
+// Forget everything learned in earlier searches, for a new game
+void clearSearchHistory()
+{
+    for (SearchThread *thread : threads)
+    {
+        clearHistory(&thread->history);
+        clearKillers(thread);
+    }
+}
+
+// Prepend move to the line found by the child
+void updatePv(SearchStack *ss, Move move)
+{
+    const SearchStack *child = ss + 1;
+
+    ss->pv[0] = move;
+    for (int i = 0; i < child->pvLength; i++)
+    {
+        ss->pv[i + 1] = child->pv[i];
+    }
+    ss->pvLength = child->pvLength + 1;
+}
+
+// Continue a principal variation that ended early with the moves stored in the transposition table,
+// stopping at the first illegal move or repeated position
+void extendPvFromTT(Board board, MoveStack &pv, int length)
+{
+    unsigned long long seen[MAX_DEPTH + 1];
+    int seenCount = 0;
+    for (int i = 0; i < pv.count; i++)
+    {
+        board.makeMove(pv.moves[i]);
+    }
+
+    while (pv.count < length && pv.count < MAX_DEPTH)
+    {
+        for (int i = 0; i < seenCount; i++)
+        {
+            if (seen[i] == board.zobristKey)
+            {
+                return;
+            }
+        }
+        seen[seenCount++] = board.zobristKey;
+
+        Move move = tt->getMove(board.zobristKey);
+        MoveList moveList;
+        generateMoves(&board, moveList);
+        bool legal = false;
+        for (int i = 0; i < moveList.count && !legal; i++)
+        {
+            legal = moveList.moves[i] == move;
+        }
+        if (!move || !legal)
+        {
+            return;
+        }
+
+        pv += move;
+        board.makeMove(move);
+    }
+}
+
+unsigned long long totalNodes()
+{
+    unsigned long long nodes = 0;
+    for (SearchThread *thread : threads)
+    {
+        nodes += thread->nodes.load(memory_order_relaxed);
+    }
+    return nodes;
+}
+
+// Permille of the transposition table in use, for the info lines
+int hashfull()
+{
+    return (int)((float)(tt->used) / (float)(tt->size) * 1000);
+}
+
+// clang-format off
+#define MIN_POLL_INTERVAL  64
+#define MAX_POLL_INTERVAL  65536
+#define NODE_POLL_INTERVAL 256 // Longest interval with a node limit
+// clang-format on
+
+// Checks the clock and the node limit. Reading the clock is too slow to do for every node,
+// so the interval is adapted to the speed of the search to keep polls about a millisecond apart.
+void pollLimits(SearchThread *thread)
+{
+    unsigned long long nodes = totalNodes();
+    if (nodeLimit && nodes >= nodeLimit)
+    {
+        stopSearch = true;
+    }
+
+    int now = timeManager.elapsed();
+    if (now - thread->lastPollTime < 1)
+    {
+        thread->pollInterval = min(thread->pollInterval * 2, MAX_POLL_INTERVAL);
+    }
+    else if (now - thread->lastPollTime > 1)
+    {
+        thread->pollInterval = max(thread->pollInterval / 2, MIN_POLL_INTERVAL);
+    }
+    if (nodeLimit)
+    {
+        thread->pollInterval = min(thread->pollInterval, NODE_POLL_INTERVAL);
+    }
+    thread->lastPollTime = now;
+    thread->pollCountdown = thread->pollInterval;
+
+    // Poll again right at the node limit, so it is exact with one thread
+    if (nodeLimit && nodes < nodeLimit && nodeLimit - nodes < (unsigned long long)thread->pollCountdown)
+    {
+        thread->pollCountdown = nodeLimit - nodes;
+    }
+
+    // The clock isn't running for us while we ponder
+    if (!ponderSearch && timeManager.isTimeLimited() && now >= timeManager.getHardLimit())
+    {
+        stopSearch = true;
+    }
 
-bool IsMate(int score) { return abs(score) > POSINF - MAX_DEPTH; }
+    // A long iteration says nothing until it ends, so keep the GUI posted
+    if (now - thread->lastInfoTime >= INFO_INTERVAL && thread->currentRootMove)
+    {
+        thread->lastInfoTime = now;
+        ostringstream info;
+        info << "info depth "       << thread->rootDepth
+             << " seldepth "        << thread->selDepth
+             << " nodes "           << nodes
+             << " nps "             << nodes * 1000 / (now + 1)
+             << " hashfull "        << hashfull()
+             << " time "            << now
+             << " currmove "        << moveToString(thread->currentRootMove)
+             << " currmovenumber "  << thread->currentRootMoveNumber;
+        sendLine(info.str());
+    }
+}
 
-float qsearch(Board *board, int ply, float alpha, float beta)
+Score qsearch(SearchThread *thread, int ply, Score alpha, Score beta)
 {
+    Board *board = &thread->board;
+    SearchDiagnostics &diagnostics = thread->diagnostics;
+
+    if (stopSearch)
+    {
+        return 0;
+    }
+
+    // Evasions are searched in check, so a long series of checks can carry qsearch to the end of the stack
+    if (ply >= MAX_DEPTH - 1)
+    {
+        return evaluate(board);
+    }
+    TREE_DUMP_ENTER(board, alpha, beta);
+
     diagnostics.qNodes++;
-    float eval = evaluate(board);
-    diagnostics.nodes++;
-    if (eval >= beta)
+    thread->nodes.store(thread->nodes.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    thread->selDepth = max(thread->selDepth, ply + 1);
+    if (thread->id == 0 && --thread->pollCountdown <= 0)
     {
-        diagnostics.cutoffs++;
-        return beta;
+        pollLimits(thread);
     }
-    if (eval > alpha)
+
+    // Any entry is deep enough here
+    TranspositionTable::Entry ttEntry;
+    bool ttHit = tt->lookup(board->zobristKey, ttEntry, ply);
+    diagnostics.ttProbes++;
+    diagnostics.ttHits += ttHit;
+    if (ttHit && (ttEntry.evalType == TranspositionTable::Exact ||
+                  (ttEntry.evalType == TranspositionTable::Lower && ttEntry.value >= beta) ||
+                  (ttEntry.evalType == TranspositionTable::Upper && ttEntry.value <= alpha)))
     {
-        alpha = eval;
+        diagnostics.ttCutoffs++;
+        TREE_DUMP_NODE(thread->id, ply, 0, ttEntry.staticEval, ttEntry.value, TreeQSearch, TreeTTCutoff);
+        return ttEntry.value;
     }
 
-    MoveList moveList;
-    generateMoves(board, moveList, true);
-    sortMoves(&moveList, 0, board, true);
-    if (moveList.count == 0)
+    bool inCheck = board->inCheck;
+    Score oldAlpha = alpha;
+    Score eval = ttHit ? ttEntry.staticEval : evaluate(board);
+    Score bestValue = NEGINF + ply;
+
+    // Stand pat, fail-soft so the caller gets the real bound.
+    // In check there is no standing pat, every evasion gets searched instead.
+    if (!inCheck)
     {
-        return eval;
+        if (eval >= beta)
+        {
+            diagnostics.standPatCutoffs++;
+            TREE_DUMP_NODE(thread->id, ply, 0, eval, eval, TreeQSearch, TreeStandPat);
+            return eval;
+        }
+        if (eval > alpha)
+        {
+            alpha = eval;
+        }
+        bestValue = eval;
     }
+
+    MoveList moveList;
+    generateMoves(board, moveList, !inCheck);
+
+    OrderingContext ordering = {};
+    ordering.history = &thread->history;
+    sortMoves(&moveList, ttHit ? ttEntry.bestMove : 0, board, !inCheck, &ordering);
+
+    Move bestMove = 0;
     for (int i = 0; i < moveList.count; i++)
     {
+        Move move = moveList.moves[i];
 
-        board->makeMove(moveList.moves[i]);
-        float value = -qsearch(board, ply + 1, -beta, -alpha);
+        if (!inCheck && !isPromotion(move))
+        {
+            // Delta pruning, even winning the captured piece for free can't bring us up to alpha
+            Score futilityValue = eval + pieceValues[Pieces::getType(board->board[getTo(move)])] + DELTA_MARGIN;
+            if (isCapture(move) && board->board[getTo(move)] != Pieces::Empty && futilityValue <= alpha)
+            {
+                bestValue = max(bestValue, futilityValue);
+                diagnostics.deltaPrunes++;
+                TREE_DUMP_MOVE(thread->id, ply, 0, move, eval, TreeQSearch, TreeDelta);
+                continue;
+            }
+
+            // Captures that lose material in the exchange
+            if (!seeAtLeast(board, move, 0))
+            {
+                diagnostics.seePrunes++;
+                TREE_DUMP_MOVE(thread->id, ply, 0, move, eval, TreeQSearch, TreeSeeCapture);
+                continue;
+            }
+        }
+
+        board->makeMove(move);
+        Score value = -qsearch(thread, ply + 1, -beta, -alpha);
         board->undoMove();
 
+        if (stopSearch)
+        {
+            return 0;
+        }
+
+        if (value > bestValue)
+        {
+            bestValue = value;
+        }
         if (value >= beta)
         {
-            return beta;
+            tt->store(board->zobristKey, 0, value, move, TranspositionTable::Lower, ply, eval);
+            TREE_DUMP_NODE(thread->id, ply, 0, eval, value, TreeQSearch, TreeBetaCutoff);
+            return value;
         }
         if (value > alpha)
         {
             alpha = value;
+            bestMove = move;
         }
     }
-    return alpha;
+
+    // Mated, only known when every evasion was searched
+    if (inCheck && moveList.count == 0)
+    {
+        TREE_DUMP_NODE(thread->id, ply, 0, eval, NEGINF + ply, TreeQSearch, TreeNoMoves);
+        return NEGINF + ply;
+    }
+
+    tt->store(board->zobristKey, 0, bestValue, bestMove,
+              bestValue > oldAlpha ? TranspositionTable::Exact : TranspositionTable::Upper, ply, eval);
+    TREE_DUMP_NODE(thread->id, ply, 0, eval, bestValue, TreeQSearch, TreeSearched);
+    return bestValue;
 }
 
-int search(Board *board, unsigned int depth, int ply, float alpha,
-           float beta, MoveStack *stack)
+// PV nodes are searched with an open window and can end up on the principal variation,
+// every other node is searched with a zero window and only has to prove a bound
+enum NodeType
+{
+    PV,
+    NonPV
+};
+
+template <NodeType nodeType>
+Score search(SearchThread *thread, unsigned int depth, int ply, Score alpha, Score beta)
 {
+    constexpr bool pvNode = nodeType == PV;
+    Board *board = &thread->board;
+    SearchDiagnostics &diagnostics = thread->diagnostics;
+    SearchStack *ss = searchStackAt(thread, ply);
+    Move excludedMove = ss->excludedMove;
 
-    // check for time
-    if (!stopSearch && chrono::duration_cast<chrono::nanoseconds>(
-                           chrono::system_clock::now().time_since_epoch())
-                                   .count() -
-                               startTime >
-                           maxTimeMS * 1000000)
+    // The singular search runs on the same ply and must not drop the line found so far
+    if (!excludedMove)
     {
-        stopSearch = true;
+        ss->pvLength = 0;
     }
 
     if (stopSearch)
@@ -134,11 +568,18 @@ int search(Board *board, unsigned int depth, int ply, float alpha,
         return 0;
     }
 
+    // Extensions can't take us past the end of the per-ply arrays
+    if (ply >= MAX_DEPTH - 1)
+    {
+        return evaluate(board);
+    }
+
     // If we are at a leaf node, we call qsearch
     if (depth == 0)
     {
-        return qsearch(board, ply, alpha, beta); // qsearch(board, ply, alpha, beta);
+        return qsearch(thread, ply, alpha, beta);
     }
+    TREE_DUMP_ENTER(board, alpha, beta);
 
     // If we aren't at a root node, we check if we can do a cutoff
     if (ply > 0)
@@ -147,51 +588,124 @@ int search(Board *board, unsigned int depth, int ply, float alpha,
         beta = min(beta, POSINF - ply);
         if (alpha >= beta)
         {
-
-            diagnostics.cutoffs++;
+            TREE_DUMP_NODE(thread->id, ply, depth, TREE_NO_EVAL, alpha, pvNode ? TreePV : TreeNonPV, TreeMateDistance);
             return alpha;
         }
     }
 
     // Transposition Table Lookup
-    int ttVal = tt->probe(board->zobristKey, depth, alpha, beta);
+    // A singular search has the same key but leaves a move out, so it can't use the entry.
+    TranspositionTable::Entry ttEntry;
+    bool ttHit = !excludedMove && tt->lookup(board->zobristKey, ttEntry, ply);
+    diagnostics.ttProbes += !excludedMove;
+    diagnostics.ttHits += ttHit;
 
-    if (ttVal != tt->failed)
+    // The root keeps its own best move, the root entry may have been overwritten by another thread
+    Move ttMove = ply == 0 ? thread->startMove : ttHit ? ttEntry.bestMove : 0;
+
+    // Only zero window nodes take cutoffs, so the root best move always comes from a move
+    // we actually searched (the table is shared between threads without locking)
+    if (!pvNode && ttHit && ttEntry.depth >= (int)depth &&
+        (ttEntry.evalType == TranspositionTable::Exact ||
+         (ttEntry.evalType == TranspositionTable::Lower && ttEntry.value >= beta) ||
+         (ttEntry.evalType == TranspositionTable::Upper && ttEntry.value <= alpha)))
     {
-        if (ply == 0)
-        {
-            bestMove.move = tt->getMove(board->zobristKey);
-            bestMove.value = ttVal;
-        }
+        diagnostics.ttCutoffs++;
+        TREE_DUMP_NODE(thread->id, ply, depth, ttEntry.staticEval, ttEntry.value, TreeNonPV, TreeTTCutoff);
 
-        diagnostics.transpositionCuttoffs++;
+        return ttEntry.value;
+    }
 
-        return ttVal;
+    // Internal iterative reduction, without a TT move the ordering is poor and this node
+    // was probably never searched before, so it is not worth the full depth yet
+    if (depth >= IIR_DEPTH && !ttMove && !excludedMove)
+    {
+        depth--;
+        diagnostics.iirReductions++;
     }
 
     // Initialize node stuff
-    diagnostics.nodes++;
-    float eval = evaluate(board);
+    thread->nodes.store(thread->nodes.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    thread->selDepth = max(thread->selDepth, ply + 1);
+    if (thread->id == 0 && --thread->pollCountdown <= 0)
+    {
+        pollLimits(thread);
+    }
+    // The static eval is stored with the entry, and a singular search already has it on the stack
+    Score eval = excludedMove ? ss->staticEval : ttHit ? ttEntry.staticEval : evaluate(board);
+    ss->staticEval = eval;
+
+    // Improving if our eval went up since our last move, pruning and reductions can then be less careful
+    bool improving = eval > (ss - 2)->staticEval;
 
     // Futility pruning
-    if (depth < 4 && !board->inCheck && eval - futilityMargin(depth) >= beta &&
+    if (!pvNode && !excludedMove && depth < 4 && !board->inCheck && eval - futilityMargin(depth) >= beta &&
         !IsMate(eval))
     {
-
-        diagnostics.cutoffs++;
         diagnostics.futilityCutoffs++;
+        TREE_DUMP_NODE(thread->id, ply, depth, eval, eval - futilityMargin(depth), TreeNonPV, TreeFutility);
 
         return eval - futilityMargin(depth);
     }
 
     // Razoring
-    if (depth == 1 && !board->inCheck && eval + RAZORING_MARGIN <= alpha &&
+    if (!pvNode && !excludedMove && depth == 1 && !board->inCheck && eval + RAZORING_MARGIN <= alpha &&
         !IsMate(eval))
     {
+        diagnostics.razoringCutoffs++;
+
+        Score value = qsearch(thread, ply, alpha, beta);
+        TREE_DUMP_NODE(thread->id, ply, depth, eval, value, TreeNonPV, TreeRazoring);
+        return value;
+    }
+
+    // ProbCut, a good capture that beats beta by a margin in a much shallower search will
+    // almost surely beat beta at full depth. Skipped if the TT already says it doesn't.
+    Score probCutBeta = beta + probCutMargin;
+    if (!pvNode && !excludedMove && depth >= PROBCUT_DEPTH && !board->inCheck && !IsMate(beta) &&
+        !(ttHit && ttEntry.depth >= (int)depth - 3 && ttEntry.value < probCutBeta))
+    {
+        MoveList captures;
+        generateMoves(board, captures, true);
+
+        OrderingContext captureOrdering = {};
+        captureOrdering.history = &thread->history;
+        sortMoves(&captures, ttMove, board, true, &captureOrdering);
 
-        diagnostics.cutoffs++;
+        for (int i = 0; i < captures.count; i++)
+        {
+            Move move = captures.moves[i];
+            if (!seeAtLeast(board, move, probCutBeta - eval))
+            {
+                continue;
+            }
 
-        return qsearch(board, ply, alpha, beta);
+            ss->currentMove = move;
+            ss->movedPiece = board->board[getFrom(move)];
+            ss->continuation = &thread->history.continuation[ss->movedPiece][getTo(move)];
+            board->makeMove(move);
+
+            // Qsearch first to throw out most captures cheaply
+            Score value = -qsearch(thread, ply + 1, -probCutBeta, -probCutBeta + 1);
+            if (value >= probCutBeta)
+            {
+                value = -search<NonPV>(thread, depth - PROBCUT_REDUCTION, ply + 1, -probCutBeta, -probCutBeta + 1);
+            }
+            board->undoMove();
+
+            if (stopSearch)
+            {
+                return 0;
+            }
+
+            if (value >= probCutBeta)
+            {
+                tt->store(board->zobristKey, depth - 3, value, move, TranspositionTable::Lower, ply, eval);
+                diagnostics.probCuts++;
+                TREE_DUMP_NODE(thread->id, ply, depth, eval, value, TreeNonPV, TreeProbCut);
+                return value;
+            }
+        }
     }
 
     MoveList moveList;
@@ -199,6 +713,7 @@ int search(Board *board, unsigned int depth, int ply, float alpha,
 
     if (moveList.count == 0)
     {
+        TREE_DUMP_NODE(thread->id, ply, depth, eval, board->inCheck ? NEGINF + ply : 0, pvNode ? TreePV : TreeNonPV, TreeNoMoves);
         if (board->inCheck)
         {
             return NEGINF + ply; // Checkmate
@@ -208,17 +723,166 @@ int search(Board *board, unsigned int depth, int ply, float alpha,
             return 0; // Stalemate
         }
     }
-    sortMoves(&moveList, startMove, board);
+    // Move ordering, the moves one and two plies ago come from the search stack
+    PieceToHistory *continuation[2] = {(ss - 1)->continuation, (ss - 2)->continuation};
+    Move *counterMove = (ss - 1)->currentMove ? &thread->history.counterMoves[(ss - 1)->movedPiece][getTo((ss - 1)->currentMove)] : nullptr;
+
+    OrderingContext ordering;
+    ordering.history = &thread->history;
+    ordering.killers = ss->killers;
+    ordering.counterMove = counterMove ? *counterMove : 0;
+    ordering.continuation[0] = continuation[0];
+    ordering.continuation[1] = continuation[1];
+
+    sortMoves(&moveList, ttMove, board, false, &ordering);
     TranspositionTable::EvalType evalType = TranspositionTable::Upper;
 
     Move bestMoveCurrent = 0; // Best move for current node
 
+    // A singular search leaves a move out, and so do the later MultiPV lines at the root
+    bool storeTT = !excludedMove && !(ply == 0 && thread->pvIndex);
+    Score bestValue = NEGINF; // Best score for current node, can be outside the window (fail-soft)
+    bool inCheck = board->inCheck;
+
+    Move quietsSearched[256]; // Moves that didn't cause a cutoff, they get a history malus
+    int quietCount = 0;
+    Move capturesSearched[256];
+    int captureCount = 0;
+    int movesSearched = 0;
+
     // Iterate through all moves
     for (int i = 0; i < moveList.count; i++)
     {
         Move move = moveList.moves[i];
+        if (move == excludedMove)
+        {
+            continue;
+        }
+        RootMove *rootMove = nullptr;
+        if (ply == 0)
+        {
+            // With MultiPV the lines already found in this iteration are left out
+            rootMove = findRootMove(thread, move);
+            if (rootMove - &thread->rootMoves[0] < thread->pvIndex)
+            {
+                continue;
+            }
+        }
+        unsigned long long nodesBefore = thread->nodes.load(memory_order_relaxed);
+        bool quiet = !isCapture(move) && !isPromotion(move);
+        int historyScore = quiet ? getQuietHistory(&ordering, board, move) : 0;
+
+        // Shallow pruning of quiet moves, only once a move has given us a score that isn't a loss
+        if (ply > 0 && quiet && !inCheck && bestValue > -MATE_BOUND)
+        {
+            // Late move pruning, this far down the ordering a quiet move is very unlikely to be best
+            int lmpCount = (LMP_BASE + depth * depth) / (2 - improving);
+            if (depth <= LMP_DEPTH && i >= lmpCount)
+            {
+                diagnostics.lateMovePrunes++;
+                TREE_DUMP_MOVE(thread->id, ply, depth, move, eval, pvNode ? TreePV : TreeNonPV, TreeLateMove);
+                continue;
+            }
+
+            // History pruning, moves that keep failing elsewhere
+            if (depth <= HISTORY_PRUNING_DEPTH && historyScore < -HISTORY_PRUNING_MARGIN * (int)depth)
+            {
+                diagnostics.historyPrunes++;
+                TREE_DUMP_MOVE(thread->id, ply, depth, move, eval, pvNode ? TreePV : TreeNonPV, TreeHistory);
+                continue;
+            }
+
+            // Quiet moves that hang material
+            if (depth <= SEE_QUIET_DEPTH && !seeAtLeast(board, move, -SEE_QUIET_MARGIN * (int)depth))
+            {
+                diagnostics.seeQuietPrunes++;
+                TREE_DUMP_MOVE(thread->id, ply, depth, move, eval, pvNode ? TreePV : TreeNonPV, TreeSeeQuiet);
+                continue;
+            }
+        }
+
+        // Singular extension, if the TT move failed high and every other move fails low against
+        // a bound a bit below its score, the TT move is the only good one and gets searched deeper
+        int extension = 0;
+        if (ply > 0 && depth >= SINGULAR_DEPTH && ply < 2 * thread->rootDepth && ttHit && move == ttMove &&
+            ttEntry.evalType != TranspositionTable::Upper && ttEntry.depth >= (int)depth - 3 &&
+            !IsMate(ttEntry.value))
+        {
+            Score singularBeta = ttEntry.value - SINGULAR_MARGIN * depth;
+            ss->excludedMove = move;
+            Score value = search<NonPV>(thread, (depth - 1) / 2, ply, singularBeta - 1, singularBeta);
+            ss->excludedMove = 0;
+
+            if (value < singularBeta)
+            {
+                extension = 1;
+                diagnostics.singularExtensions++;
+            }
+            else if (singularBeta >= beta)
+            {
+                // Multi-cut, even without the TT move another move beats beta
+                diagnostics.multiCuts++;
+                TREE_DUMP_NODE(thread->id, ply, depth, eval, singularBeta, pvNode ? TreePV : TreeNonPV, TreeMultiCut);
+                return singularBeta;
+            }
+        }
+
+        ss->currentMove = move;
+        ss->movedPiece = board->board[getFrom(move)];
+        ss->continuation = &thread->history.continuation[ss->movedPiece][getTo(move)];
+
         board->makeMove(move);
-        float value = -search(board, depth - 1, ply + 1, -beta, -alpha, (stack + 1));
+        bool givesCheck = board->inCheck;
+        movesSearched++;
+        if (ply == 0)
+        {
+            thread->currentRootMove = move;
+            thread->currentRootMoveNumber = thread->pvIndex + movesSearched;
+        }
+
+        // Check extension, don't let the horizon cut a line of checks short
+        if (givesCheck && ply < 2 * thread->rootDepth && !extension)
+        {
+            extension = 1;
+            diagnostics.checkExtensions++;
+        }
+        unsigned int newDepth = depth - 1 + extension;
+
+        // Late move reductions, quiet moves this far down the list rarely turn out best
+        // so they get a shallower search first
+        int reduction = 0;
+        if (depth >= LMR_MIN_DEPTH && i >= LMR_MIN_MOVES && !inCheck && quiet)
+        {
+            reduction = lmrReductions[depth][min(i, 63)];
+            reduction -= pvNode;
+            reduction -= givesCheck;
+            reduction += !improving;
+            reduction -= historyScore / LMR_HISTORY_DIV;
+            reduction = max(0, min(reduction, (int)newDepth - 1));
+        }
+
+        // Principal variation search, the first move gets the full window and the rest
+        // only have to prove they are no better. Anything that does gets searched again,
+        // first without the reduction and then with the full window
+        Score value;
+        if (movesSearched == 1)
+        {
+            value = -search<nodeType>(thread, newDepth, ply + 1, -beta, -alpha);
+        }
+        else
+        {
+            value = -search<NonPV>(thread, newDepth - reduction, ply + 1, -alpha - 1, -alpha);
+            diagnostics.reducedMoves += reduction > 0;
+            if (reduction && value > alpha)
+            {
+                diagnostics.reducedResearches++;
+                value = -search<NonPV>(thread, newDepth, ply + 1, -alpha - 1, -alpha);
+            }
+            if (pvNode && value > alpha && value < beta)
+            {
+                value = -search<PV>(thread, newDepth, ply + 1, -beta, -alpha);
+            }
+        }
         board->undoMove();
 
         if (stopSearch)
@@ -226,128 +890,541 @@ int search(Board *board, unsigned int depth, int ply, float alpha,
             return 0;
         }
 
-        if (value >= beta)
+        if (value > bestValue)
         {
-            tt->store(board->zobristKey, depth, value, move,
-                      TranspositionTable::Lower);
-
-            return beta;
+            bestValue = value;
+        }
+        if (ply == 0)
+        {
+            // Only the first move and moves that raise alpha get a real score, the rest keep
+            // their order behind them when the root moves are sorted
+            rootMove->nodes += thread->nodes.load(memory_order_relaxed) - nodesBefore;
+            rootMove->score = NEGINF;
+            if (movesSearched == 1 || value > alpha)
+            {
+                rootMove->score = value;
+                rootMove->depth = thread->rootDepth;
+                rootMove->pv.count = 0;
+                rootMove->pv += move;
+            }
         }
         if (value > alpha)
         {
-            alpha = value;
-            evalType = TranspositionTable::Exact;
+            if (pvNode)
+            {
+                updatePv(ss, move);
+            }
             if (ply == 0)
             {
-                bestMove.move = move;
-                bestMove.value = value;
-                cout << "info string current best " << moveToString(bestMove.move) << "\n";
+                rootMove->pv.count = 0;
+                for (int j = 0; j < ss->pvLength; j++)
+                {
+                    rootMove->pv += ss->pv[j];
+                }
             }
+            if (ply == 0 && thread->pvIndex == 0)
+            {
+                thread->bestMove.move = move;
+                thread->bestMove.value = value;
+            }
+            if (value >= beta)
+            {
+                if (storeTT)
+                {
+                    tt->store(board->zobristKey, depth, value, move,
+                              TranspositionTable::Lower, ply, eval);
+                }
+
+                diagnostics.betaCutoffs++;
+                diagnostics.firstMoveCutoffs += movesSearched == 1;
+
+                updateCaptureHistory(&thread->history, board, move, capturesSearched, captureCount, depth);
+                if (quiet)
+                {
+                    Move *killers = ss->killers;
+                    if (killers[0] != move)
+                    {
+                        killers[1] = killers[0];
+                        killers[0] = move;
+                    }
+                    updateQuietHistory(&thread->history, continuation, board, move, quietsSearched, quietCount, depth);
+                    if (counterMove)
+                    {
+                        *counterMove = move;
+                    }
+                }
+
+                TREE_DUMP_NODE(thread->id, ply, depth, eval, value, pvNode ? TreePV : TreeNonPV, TreeBetaCutoff);
+                return value;
+            }
+            alpha = value;
+            evalType = TranspositionTable::Exact;
             bestMoveCurrent = move;
-            update_path(stack, move, (stack + 1));
         }
+
+        if (quiet)
+        {
+            quietsSearched[quietCount++] = move;
+        }
+        else if (isCapture(move))
+        {
+            capturesSearched[captureCount++] = move;
+        }
+    }
+    // The excluded move may have been the only legal one
+    if (!movesSearched)
+    {
+        TREE_DUMP_NODE(thread->id, ply, depth, eval, alpha, pvNode ? TreePV : TreeNonPV, TreeSearched);
+        return alpha;
     }
-    tt->store(board->zobristKey, depth, alpha, bestMoveCurrent, evalType);
 
-    return alpha;
+    if (storeTT)
+    {
+        tt->store(board->zobristKey, depth, bestValue, bestMoveCurrent, evalType, ply, eval);
+    }
+
+    TREE_DUMP_NODE(thread->id, ply, depth, eval, bestValue, pvNode ? TreePV : TreeNonPV, TreeSearched);
+    return bestValue;
 }
 
-void startIterativeDeepening(Board *board, unsigned int maxDepth,
-                             int maxTime = 0, int maxNodes = 0)
+void startIterativeDeepening(SearchThread *thread, SearchLimits limits)
 {
-    diagnostics.nodes = 0;
-    diagnostics.qNodes = 0;
-    diagnostics.time = 0;
-    diagnostics.cutoffs = 0;
-    diagnostics.futilityCutoffs = 0;
-    diagnostics.transpositionCuttoffs = 0;
+    // The per-ply and per-depth tables end at MAX_DEPTH, "go depth" can ask for anything
+    unsigned int maxDepth = min(limits.depth, (unsigned int)MAX_DEPTH);
+    SearchDiagnostics &diagnostics = thread->diagnostics;
+    MoveVal &bestMove = thread->bestMove;
+    bool mainThread = thread->id == 0;
+    SearchStack *root = searchStackAt(thread, 0);
 
-    startMove = 0;
+    thread->pollCountdown = 1;
+    thread->pollInterval = MIN_POLL_INTERVAL;
+    thread->lastPollTime = 0;
+    thread->lastInfoTime = 0;
+    thread->currentRootMove = 0;
+
+    thread->nodes = 0;
+    diagnostics = SearchDiagnostics();
+
+    thread->startMove = 0;
+    thread->completedDepth = 0;
+    thread->pvIndex = 0;
 
     MoveVal prevBestMove = bestMove;
 
     for (int i = 1; i <= maxDepth; i++)
     {
-        unsigned long long startDepthTime =
-            chrono::duration_cast<chrono::milliseconds>(
-                chrono::system_clock::now().time_since_epoch())
-                .count();
-        diagnostics.time = startDepthTime;
+        // Depth diversification for the helper threads
+        if (!mainThread)
+        {
+            int slot = (thread->id - 1) % 20;
+            if (((i + skipPhase[slot]) / skipSize[slot]) % 2)
+            {
+                continue;
+            }
+        }
 
-        startMove = bestMove.move;
-        prevBestMove = bestMove;
+        unsigned long long startDepthNodes = mainThread ? totalNodes() : 0;
 
-        bestMove.move = 0;
-        bestMove.value = NEGINF;
+        thread->rootDepth = i;
+        thread->selDepth = 0;
+        prevBestMove = bestMove;
 
-        MoveStack stack[MAX_DEPTH];
-        MoveStack *bestStack = stack;
+        for (RootMove &rootMove : thread->rootMoves)
+        {
+            rootMove.previousScore = rootMove.score;
+        }
 
-        for (int d = 0; d < MAX_DEPTH; d++)
+        // MultiPV, search the best line, then the best line without that move and so on.
+        // Each line reuses the transposition table and ordering the earlier ones filled.
+        int lines = mainThread ? min(multiPV, (int)thread->rootMoves.size()) : 1;
+        for (thread->pvIndex = 0; thread->pvIndex < lines; thread->pvIndex++)
         {
-            stack[d].count = 0;
-            for (int j = 0; j < MAX_DEPTH; j++)
+            RootMove &line = thread->rootMoves[thread->pvIndex];
+            thread->startMove = line.move;
+
+            if (thread->pvIndex == 0)
             {
-                stack[d].moves[j] = 0;
+                bestMove.move = 0;
+                bestMove.value = NEGINF;
             }
-        }
 
-        search(board, i, 0, NEGINF, POSINF, bestStack);
+            // Aspiration windows, expect the score to stay close to the previous iteration's
+            // and widen the window on whichever side it falls out of
+            Score delta = ASPIRATION_DELTA;
+            Score alpha = NEGINF;
+            Score beta = POSINF;
+            if (i >= ASPIRATION_DEPTH && !IsMate(line.previousScore))
+            {
+                alpha = max(line.previousScore - delta, NEGINF);
+                beta = min(line.previousScore + delta, POSINF);
+            }
+
+            while (true)
+            {
+                Score score = search<PV>(thread, i, 0, alpha, beta);
+
+                if (stopSearch)
+                {
+                    break;
+                }
+
+                const char *bound;
+                if (score <= alpha)
+                {
+                    // Fail low, the best move is in trouble and the time manager should know
+                    beta = (alpha + beta) / 2;
+                    alpha = max(score - delta, NEGINF);
+                    bound = " upperbound";
+                    if (mainThread && thread->pvIndex == 0)
+                    {
+                        timeManager.reportFailLow();
+                    }
+                }
+                else if (score >= beta)
+                {
+                    beta = min(score + delta, POSINF);
+                    bound = " lowerbound";
+                }
+                else
+                {
+                    break;
+                }
+                delta += delta / 2;
+
+                if (mainThread)
+                {
+                    ostringstream info;
+                    info << "info depth " << i
+                         << " seldepth "  << thread->selDepth
+                         << " multipv "   << thread->pvIndex + 1
+                         << " score "     << scoreToString(score) << bound
+                         << " nodes "     << totalNodes()
+                         << " time "      << timeManager.elapsed();
+                    // A fail low has no move above alpha, so only a fail high has a line to show
+                    if (root->pvLength)
+                    {
+                        info << " pv";
+                        for (int j = 0; j < root->pvLength; j++)
+                        {
+                            info << " " << moveToString(root->pv[j]);
+                        }
+                    }
+                    sendLine(info.str());
+                }
+            }
+
+            if (stopSearch)
+            {
+                break;
+            }
+
+            // Bring the line just found to pvIndex, stable so unscored moves keep their order
+            stable_sort(thread->rootMoves.begin() + thread->pvIndex, thread->rootMoves.end(),
+                        [](const RootMove &a, const RootMove &b) { return a.score > b.score; });
+        }
 
         if (stopSearch)
         {
-            cout << "info string stopping search, using search results from depth " << i - 1 << "\n";
+            if (mainThread)
+            {
+                sendLine("info string stopping search, using search results from depth " + to_string(i - 1));
+                if (thread->completedDepth)
+                {
+                    ostringstream info;
+                    info << "info depth " << thread->completedDepth
+                         << " score "     << scoreToString(prevBestMove.value)
+                         << " pv "        << thread->pv;
+                    sendLine(info.str());
+                }
+            }
             bestMove = prevBestMove;
             break;
         }
 
-        unsigned long long currentTime =
-            chrono::duration_cast<chrono::milliseconds>(
-                chrono::system_clock::now().time_since_epoch())
-                .count();
+        thread->completedDepth = i;
+        if (mainThread)
+        {
+            diagnostics.nodesByDepth[i] = totalNodes() - startDepthNodes;
+        }
+        bestMove.move = thread->rootMoves[0].move;
+        bestMove.value = thread->rootMoves[0].score;
+
+        // Lines cut short are continued from the table
+        for (int k = 0; k < lines; k++)
+        {
+            extendPvFromTT(thread->board, thread->rootMoves[k].pv, i);
+        }
+        thread->pv = thread->rootMoves[0].pv;
 
-        int used = (float)(tt->used) / (float)(tt->size) * 1000;
+        if (mainThread)
+        {
+            int currentTime = timeManager.elapsed();
 
-        cout << "info depth "   << i
-             << " score cp "    << bestMove.value
-             << " nodes "       << diagnostics.nodes 
-             << " nps "         << (int)((double)diagnostics.nodes / (double)(currentTime - startDepthTime + 1) * 1000)
-             << " hashfull "    << used 
-             << " pv "          << moveToString(bestMove.move) 
-             << " time "        << currentTime - startDepthTime << "\n";
+            // UCI wants nodes and time since "go", not for this iteration
+            unsigned long long nodes = totalNodes();
 
-        diagnostics.nodes = 0;
-        diagnostics.qNodes = 0;
-        diagnostics.time = 0;
-        diagnostics.cutoffs = 0;
-        diagnostics.futilityCutoffs = 0;
-        diagnostics.transpositionCuttoffs = 0;
+            for (int k = 0; k < lines; k++)
+            {
+                const RootMove &rootMove = thread->rootMoves[k];
+                ostringstream info;
+                info << "info depth "   << i
+                     << " seldepth "    << thread->selDepth
+                     << " multipv "     << k + 1
+                     << " score "       << scoreToString(rootMove.score)
+                     << " nodes "       << nodes
+                     << " nps "         << nodes * 1000 / (currentTime + 1)
+                     << " hashfull "    << hashfull()
+                     << " time "        << currentTime
+                     << " pv "          << rootMove.pv;
+                sendLine(info.str());
+            }
+        }
 
-        if (diagnostics.nodes > maxNodes && maxNodes != 0)
+        if (i == maxDepth && maxDepth != 0)
         {
             break;
         }
-        if (i == maxDepth && maxDepth != 0)
+
+        // Only the main thread decides when the search is over, the helpers get stopped by it
+        if (mainThread && !ponderSearch && timeManager.stopAfterIteration(i, bestMove.move, bestMove.value))
         {
             break;
         }
     }
 }
 
-Move startSearch(Board *board, unsigned int depth, int maxTime, int maxNodes,
-                 int wtime, int btime)
+// Sums what every thread counted into lastStats
+void collectStats(int completedDepth)
+{
+    SearchDiagnostics &total = lastStats;
+    total = threads[0]->diagnostics; // Only the main thread counts nodes by depth
+    total.nodes = totalNodes();
+    total.completedDepth = completedDepth;
+    total.time = timeManager.elapsed();
+
+    for (size_t i = 1; i < threads.size(); i++)
+    {
+        const SearchDiagnostics &d = threads[i]->diagnostics;
+        total.qNodes += d.qNodes;
+        total.ttProbes += d.ttProbes;
+        total.ttHits += d.ttHits;
+        total.ttCutoffs += d.ttCutoffs;
+        total.betaCutoffs += d.betaCutoffs;
+        total.firstMoveCutoffs += d.firstMoveCutoffs;
+        total.standPatCutoffs += d.standPatCutoffs;
+        total.futilityCutoffs += d.futilityCutoffs;
+        total.razoringCutoffs += d.razoringCutoffs;
+        total.probCuts += d.probCuts;
+        total.deltaPrunes += d.deltaPrunes;
+        total.seePrunes += d.seePrunes;
+        total.lateMovePrunes += d.lateMovePrunes;
+        total.historyPrunes += d.historyPrunes;
+        total.seeQuietPrunes += d.seeQuietPrunes;
+        total.iirReductions += d.iirReductions;
+        total.reducedMoves += d.reducedMoves;
+        total.reducedResearches += d.reducedResearches;
+        total.checkExtensions += d.checkExtensions;
+        total.singularExtensions += d.singularExtensions;
+        total.multiCuts += d.multiCuts;
+    }
+}
+
+unsigned long long getSearchNodes() { return lastStats.nodes; }
+
+double percent(unsigned long long part, unsigned long long whole)
+{
+    return whole ? 100.0 * part / whole : 0;
+}
+
+// Dumps the statistics of the last search, as info strings so a GUI can show them
+void printSearchStats()
+{
+    const SearchDiagnostics &s = lastStats;
+    ostringstream out;
+    out << fixed;
+    out.precision(1);
+    out << "info string stats depth " << s.completedDepth << " time " << s.time << " nodes " << s.nodes
+         << " nps " << s.nodes * 1000 / (s.time + 1) << " threads " << threads.size() << "\n";
+
+    // Effective branching factor, the growth of the iteration size over the last few iterations
+    out << "info string stats nodes by depth";
+    for (int d = 1; d <= s.completedDepth; d++)
+    {
+        out << " " << s.nodesByDepth[d];
+    }
+    int from = max(1, s.completedDepth - 4);
+    if (s.completedDepth > from && s.nodesByDepth[from])
+    {
+        out << " ebf " << pow((double)s.nodesByDepth[s.completedDepth] / s.nodesByDepth[from],
+                               1.0 / (s.completedDepth - from));
+    }
+    out << "\n";
+
+    out << "info string stats beta cutoffs " << s.betaCutoffs
+         << " first move " << percent(s.firstMoveCutoffs, s.betaCutoffs) << "%"
+         << " qsearch nodes " << s.qNodes << " (" << percent(s.qNodes, s.nodes) << "%)"
+         << " stand pat cutoffs " << s.standPatCutoffs << "\n";
+    out << "info string stats tt probes " << s.ttProbes
+         << " hits " << percent(s.ttHits, s.ttProbes) << "%"
+         << " cutoffs " << percent(s.ttCutoffs, s.ttProbes) << "%\n";
+    out << "info string stats pruning futility " << s.futilityCutoffs
+         << " razoring " << s.razoringCutoffs
+         << " probcut " << s.probCuts
+         << " late move " << s.lateMovePrunes
+         << " history " << s.historyPrunes
+         << " see quiet " << s.seeQuietPrunes
+         << " delta " << s.deltaPrunes
+         << " see capture " << s.seePrunes << "\n";
+    out << "info string stats reductions iir " << s.iirReductions
+         << " lmr " << s.reducedMoves << " (" << percent(s.reducedResearches, s.reducedMoves) << "% searched again)"
+         << " extensions check " << s.checkExtensions
+         << " singular " << s.singularExtensions
+         << " multicut " << s.multiCuts;
+    sendLine(out.str());
+}
+
+Move startSearch(Board *board, const SearchLimits &limits)
 {
     // Initialize search
-    startTime = chrono::duration_cast<chrono::nanoseconds>(
-                    chrono::system_clock::now().time_since_epoch())
-                    .count();
-    maxTimeMS = maxTime == 0 ? 10000000 : maxTime - 50; // Subtract 50ms to be safe
-    stopSearch = false;
-
-    bestMove.value = -100000;
-    bestMove.move = 0;
-    startIterativeDeepening(board, depth, maxTime, maxNodes);
-    return bestMove.move;
+    timeManager.start(limits, board->isWhite);
+    nodeLimit = limits.nodes;
+    lastPv.count = 0;
+    lastStats = SearchDiagnostics();
+    tt->newSearch();
+
+    MoveList moveList;
+    generateMoves(board, moveList);
+    if (moveList.count == 0)
+    {
+        sendLine(string("info depth 0 score ") + (board->inCheck ? "mate 0" : "cp 0"));
+        return 0;
+    }
+
+    // Nothing to think about with a single legal move when the clock is running
+    if (timeManager.isTimeLimited() && !limits.ponder && moveList.count == 1)
+    {
+        return moveList.moves[0];
+    }
+
+    if (threads.empty())
+    {
+        setThreadCount(1);
+    }
+
+    // A search stopped before the first iteration finishes still has to answer with a legal move,
+    // the best guess is the one move ordering puts first
+    TranspositionTable::Entry ttEntry;
+    Move ttMove = tt->lookup(board->zobristKey, ttEntry, 0) ? ttEntry.bestMove : 0;
+    OrderingContext ordering = {};
+    ordering.history = &threads[0]->history;
+    MoveList orderedMoves = moveList;
+    sortMoves(&orderedMoves, ttMove, board, false, &ordering);
+
+    for (SearchThread *thread : threads)
+    {
+        thread->board = *board;
+        ageHistory(&thread->history);
+        clearKillers(thread); // The same ply is a different position in the new search
+        thread->bestMove.value = -100000;
+        thread->bestMove.move = orderedMoves.moves[0];
+        thread->completedDepth = 0;
+        thread->pv.count = 0;
+
+        thread->rootMoves.clear();
+        for (int i = 0; i < moveList.count; i++)
+        {
+            RootMove rootMove = {};
+            rootMove.move = moveList.moves[i];
+            rootMove.score = rootMove.previousScore = NEGINF;
+            thread->rootMoves.push_back(rootMove);
+        }
+    }
+
+    TREE_DUMP_START(threads.size());
+
+    // Lazy SMP, the helpers search the same position and only talk to each other through the transposition table
+    vector<std::thread> helpers;
+    for (size_t i = 1; i < threads.size(); i++)
+    {
+        helpers.emplace_back(startIterativeDeepening, threads[i], limits);
+    }
+
+    SearchThread *mainThread = threads[0];
+    startIterativeDeepening(mainThread, limits);
+
+    // A ponder or infinite search may not return before the GUI sends "ponderhit" or "stop"
+    while ((ponderSearch || infiniteSearch) && !stopSearch)
+    {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    stopSearch = true;
+    for (std::thread &helper : helpers)
+    {
+        helper.join();
+    }
+    TREE_DUMP_FINISH();
+
+    // Take the result from the thread that finished the deepest iteration
+    SearchThread *best = mainThread;
+    for (SearchThread *thread : threads)
+    {
+        if (thread->completedDepth > best->completedDepth && thread->bestMove.move)
+        {
+            best = thread;
+        }
+    }
+
+    collectStats(best->completedDepth);
+
+    ostringstream info;
+    if (best != mainThread)
+    {
+        info << "info string using helper thread " << best->id << " result from depth " << best->completedDepth << "\n";
+        info << "info depth " << best->completedDepth
+             << " score "     << scoreToString(best->bestMove.value)
+             << " pv "        << best->pv << "\n";
+    }
+    info << "info string total nodes " << totalNodes() << " threads " << threads.size()
+         << " first move cutoffs " << (int)(100.0 * lastStats.firstMoveCutoffs / max(lastStats.betaCutoffs, 1ULL)) << "%";
+    sendLine(info.str());
+    if (debugMode)
+    {
+        printSearchStats();
+    }
+
+    lastPv = best->pv;
+    return best->bestMove.move;
+}
+
+// The expected reply to bestMove, taken from the principal variation or else the transposition table
+// so we have something to ponder on
+Move getPonderMove(Board *board, Move bestMove)
+{
+    if (!bestMove)
+    {
+        return 0;
+    }
+    if (lastPv.count >= 2 && lastPv.moves[0] == bestMove)
+    {
+        return lastPv.moves[1];
+    }
+
+    Board ponderBoard = *board;
+    ponderBoard.makeMove(bestMove);
+    Move ponderMove = tt->getMove(ponderBoard.zobristKey);
+
+    // The table is shared and can be overwritten, only return the move if it is legal here
+    MoveList moveList;
+    generateMoves(&ponderBoard, moveList);
+    for (int i = 0; i < moveList.count; i++)
+    {
+        if (moveList.moves[i] == ponderMove)
+        {
+            return ponderMove;
+        }
+    }
+    return 0;
 }
 
 unsigned long long perft(Board *board, const unsigned int depth)
@@ -1,12 +1,15 @@
 #ifndef SEARCH_H
 #define SEARCH_H
 
+#include <atomic>
 #include <cmath>
 
 #include "../representation/board.h"
 #include "transposition.h"
+#include "timeman.h"
 
-
+#define PROBCUT_MARGIN 200  // Default of the ProbCutMargin option
+#define MAX_HASH_MB    1024 // Largest transposition table, in MB
 
 struct MoveStack {
     Move moves[256];
@@ -19,8 +22,26 @@ inline void operator+=(MoveStack &a, Move b) {
 }
 
 
+extern atomic<bool> stopSearch;     // Set by the input thread on "stop"/"quit" or by the search on timeout
+extern atomic<bool> ponderSearch;   // True while searching on the opponent's time, cleared by "ponderhit"
+extern atomic<bool> infiniteSearch; // True for "go infinite", the search then only ends on "stop"
+extern atomic<bool> debugMode;      // Set by "debug on", prints the statistics after every search
+
 extern unsigned long long startPerft(Board board, unsigned int depth);
-extern Move startSearch(Board *board, unsigned int depth, int maxTime, int maxNodes, int wtime, int btime);
+extern Move startSearch(Board *board, const SearchLimits &limits);
+extern void initSearch();
+extern Move getPonderMove(Board *board, Move bestMove);
 extern void clearTTSearch();
+extern void setHashSize(int megabytes);
+extern int getHashSize();
+extern void clearSearchHistory();
+extern void setThreadCount(int count);
+extern int getThreadCount();
+extern void setMultiPV(int lines);
+extern int getMultiPV();
+extern void setProbCutMargin(int margin);
+extern int getProbCutMargin();
+extern void printSearchStats();
+extern unsigned long long getSearchNodes(); // Nodes of the last search, over all threads
 
 #endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include <algorithm>
+
+#include "timeman.h"
+
+using namespace std;
+
+// clang-format off
+#define DEFAULT_MOVES_TO_GO  30
+#define MAX_MOVES_TO_GO      50
+#define HARD_LIMIT_FACTOR    5   // Hard limit as a multiple of the soft limit
+#define MAX_TIME_SHARE       0.8 // Never plan to use more than this share of the clock
+#define MIN_HARD_LIMIT       5   // Milliseconds, enough to finish at least the first iteration
+// clang-format on
+
+TimeManager timeManager;
+
+void TimeManager::start(const SearchLimits &limits, bool isWhite)
+{
+    startTime = chrono::steady_clock::now();
+    lastIterationEnd = 0;
+    lastBestMove = 0;
+    lastScore = 0;
+    bestMoveChanges = 0;
+    failLows = 0;
+
+    int time = isWhite ? limits.wtime : limits.btime;
+    int inc = isWhite ? limits.winc : limits.binc;
+    fixedTime = limits.moveTime != 0;
+
+    if (limits.moveTime)
+    {
+        timeLimited = true;
+        softLimit = hardLimit = max(MIN_HARD_LIMIT, (int)limits.moveTime - moveOverhead);
+    }
+    else if (time)
+    {
+        timeLimited = true;
+
+        int movesToGo = limits.movesToGo ? min((int)limits.movesToGo, MAX_MOVES_TO_GO) : DEFAULT_MOVES_TO_GO;
+
+        // Time we can count on until the next time control, keeping the overhead for every move.
+        // On a short clock that reserve would eat everything, so it never takes more than half.
+        int overhead = min(moveOverhead * movesToGo, time / 2);
+        int timeLeft = max(1, time + inc * (movesToGo - 1) - overhead);
+
+        // The last move before the time control may use everything we have left
+        int maxTime = movesToGo == 1 ? time - moveOverhead : (int)(time * MAX_TIME_SHARE) - moveOverhead;
+        maxTime = max(1, maxTime);
+
+        softLimit = max(1, min(timeLeft / movesToGo, maxTime));
+        hardLimit = max(MIN_HARD_LIMIT, min(softLimit * HARD_LIMIT_FACTOR, maxTime));
+    }
+    else
+    {
+        timeLimited = false;
+        softLimit = hardLimit = 0;
+    }
+}
+
+int TimeManager::elapsed()
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startTime).count();
+}
+
+// Called after every completed iteration, returns true if starting another one isn't worth it
+bool TimeManager::stopAfterIteration(int depth, Move bestMove, int score)
+{
+    int now = elapsed();
+    int iterationTime = now - lastIterationEnd;
+    lastIterationEnd = now;
+
+    // A best move that keeps changing needs more time to settle, older changes count less
+    bestMoveChanges *= 0.5;
+    if (depth > 1 && bestMove != lastBestMove)
+    {
+        bestMoveChanges += 1;
+    }
+
+    double scale = 1 + bestMoveChanges;
+
+    // So does a score that is dropping
+    int scoreDrop = depth > 1 ? lastScore - score : 0;
+    if (scoreDrop > 100)
+    {
+        scale *= 1.6;
+    }
+    else if (scoreDrop > 30)
+    {
+        scale *= 1.3;
+    }
+
+    // An aspiration fail low at the root means the score fell more than the window in one iteration
+    if (failLows)
+    {
+        scale *= 1 + 0.2 * min(failLows, 3);
+        failLows = 0;
+    }
+
+    lastBestMove = bestMove;
+    lastScore = score;
+
+    // Without a clock to manage only the hard limit stops the search
+    if (!timeLimited || fixedTime)
+    {
+        return false;
+    }
+
+    int target = min((int)(softLimit * scale), hardLimit);
+    if (now >= target)
+    {
+        return true;
+    }
+
+    // The next iteration takes at least twice as long as this one, don't start it if it can't finish
+    return now + 2 * iterationTime > hardLimit;
+}
@@ -0,0 +1,57 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+#include <chrono>
+
+#include "../representation/move.h"
+
+// Everything the "go" command can limit a search by, 0 means no limit
+struct SearchLimits
+{
+    unsigned int depth = 0;
+    unsigned int nodes = 0;
+    unsigned int moveTime = 0;
+    unsigned int wtime = 0;
+    unsigned int btime = 0;
+    unsigned int winc = 0;
+    unsigned int binc = 0;
+    unsigned int movesToGo = 0;
+    unsigned int mate = 0; // Look for a mate in this many moves instead of the best move
+    bool ponder = false;
+    bool infinite = false; // Keep searching until "stop", even once the depth limit is reached
+};
+
+// Decides how long a search may take.
+// The soft limit is checked between iterations and stretched when the search looks unstable,
+// the hard limit aborts the search wherever it is.
+class TimeManager
+{
+private:
+    std::chrono::steady_clock::time_point startTime;
+    bool timeLimited;
+    bool fixedTime; // "go movetime", search until the hard limit
+    int softLimit;
+    int hardLimit;
+
+    // Iteration history for the stop decision
+    int lastIterationEnd;
+    Move lastBestMove;
+    int lastScore;
+    double bestMoveChanges;
+    int failLows; // Root fail lows since the last completed iteration
+
+public:
+    int moveOverhead = 50; // Milliseconds lost between us and the GUI for each move
+
+    void start(const SearchLimits &limits, bool isWhite);
+    int elapsed();
+    bool isTimeLimited() { return timeLimited; }
+    int getSoftLimit() { return softLimit; }
+    int getHardLimit() { return hardLimit; }
+    bool stopAfterIteration(int depth, Move bestMove, int score);
+    void reportFailLow() { failLows++; }
+};
+
+extern TimeManager timeManager;
+
+#endif
@@ -2,27 +2,75 @@
 
 #include "transposition.h"
 
+TranspositionTable::Entry TranspositionTable::read(int index)
+{
+    const Slot &slot = table[index];
+    uint64_t data0 = slot.data[0].load(std::memory_order_relaxed);
+    uint64_t data1 = slot.data[1].load(std::memory_order_relaxed);
+
+    Entry entry;
+    entry.zobrist = slot.key.load(std::memory_order_relaxed) ^ data0 ^ data1;
+    entry.value = (int32_t)(uint32_t)data0;
+    entry.bestMove = (Move)(data0 >> 32);
+    entry.staticEval = (int16_t)(uint16_t)data1;
+    entry.depth = (char)(data1 >> 16);
+    entry.evalType = (EvalType)(data1 >> 24);
+    entry.generation = (uint8_t)(data1 >> 32);
+    return entry;
+}
+
+void TranspositionTable::write(int index, const Entry &entry)
+{
+    uint64_t data0 = (uint32_t)entry.value | (uint64_t)entry.bestMove << 32;
+    uint64_t data1 = (uint16_t)entry.staticEval | (uint64_t)(uint8_t)entry.depth << 16 |
+                     (uint64_t)entry.evalType << 24 | (uint64_t)entry.generation << 32;
+
+    Slot &slot = table[index];
+    slot.key.store(entry.zobrist ^ data0 ^ data1, std::memory_order_relaxed);
+    slot.data[0].store(data0, std::memory_order_relaxed);
+    slot.data[1].store(data1, std::memory_order_relaxed);
+}
 
-void TranspositionTable::store(unsigned long long zobrist, int depth, int value, Move bestMove, EvalType evalType)
+void TranspositionTable::store(unsigned long long zobrist, int depth, Score value, Move bestMove, EvalType evalType, int ply,
+                               Score staticEval)
 {
     int index = zobrist % size;
-    Entry entry = table[index];
+    Entry entry = read(index);
     if (entry.evalType == NOTINIT)
     {
         used++;
     }
+    else if (entry.zobrist == zobrist)
+    {
+        // Don't let a shallow bound overwrite a deeper search of the same position
+        if (evalType != Exact && depth < entry.depth - 2)
+        {
+            return;
+        }
+        if (!bestMove)
+        {
+            bestMove = entry.bestMove;
+        }
+    }
+    else if (entry.generation == generation && entry.depth > 0 && depth == 0)
+    {
+        // Qsearch stores far more positions than the main search, left alone they would keep
+        // replacing its entries. Those from earlier searches are fair game.
+        return;
+    }
     entry.zobrist = zobrist;
     entry.depth = depth;
-    entry.value = value;
+    entry.value = scoreToTT(value, ply);
     entry.bestMove = bestMove;
     entry.evalType = evalType;
-    table[index] = entry;
+    entry.staticEval = staticEval;
+    entry.generation = generation;
+    write(index, entry);
 }
 
 Move TranspositionTable::getMove(unsigned long long zobrist)
 {
-    int index = zobrist % size;
-    Entry entry = table[index];
+    Entry entry = read(zobrist % size);
     if (entry.zobrist == zobrist)
     {
         return entry.bestMove;
@@ -30,56 +78,38 @@ Move TranspositionTable::getMove(unsigned long long zobrist)
     return failed;
 }
 
-int TranspositionTable::probe(unsigned long long zobrist, int depth, int alpha, int beta)
+// Reads the entry for a position whatever its bound, the value is adjusted to the ply it is probed from
+bool TranspositionTable::lookup(unsigned long long zobrist, Entry &entry, int ply)
 {
-    unsigned int index = zobrist % size;
-    Entry entry = table[index];
-    if (entry.zobrist == zobrist && entry.depth >= depth)
+    entry = read(zobrist % size);
+    if (entry.zobrist != zobrist || entry.evalType == NOTINIT)
     {
-        int score = entry.value;
-
-        if (entry.evalType == Exact)
-        {
-            return score;
-        }
-
-        if (entry.evalType == Upper && score <= alpha)
-        {
-            return score;
-        }
-
-        if (entry.evalType == Lower && score >= beta)
-        {
-            return score;
-        }
+        return false;
     }
-    return failed;
+    entry.value = scoreFromTT(entry.value, ply);
+    return true;
 }
 
 void TranspositionTable::clear()
 {
+    Entry empty = {};
+    empty.evalType = NOTINIT;
     for (int i = 0; i < size; i++)
     {
-        table[i].zobrist = 0;
+        write(i, empty);
     }
+    used = 0;
 }
 
 TranspositionTable::TranspositionTable(int size)
 {
-    int entrySize = sizeof Entry();
+    int entrySize = sizeof(Slot);
     this->size = (int)(size / entrySize);
-    this->table = new Entry[this->size];
-    for (int i = 0; i < this->size; i++)
-    {
-        table[i].evalType = NOTINIT;
-        table[i].zobrist = 0;
-        table[i].depth = 0;
-        table[i].value = 0;
-        table[i].bestMove = 0;
-    }
+    this->table = new Slot[this->size];
+    clear();
     for (int i = 0; i < this->size; i++)
     {
-        Entry t = table[i];
+        Entry t = read(i);
         assert(t.evalType == NOTINIT);
     }
 }
@@ -1,6 +1,9 @@
 #ifndef TRANSPOSITION_H
 #define TRANSPOSITION_H
 
+#include <atomic>
+
+#include "score.h"
 #include "../representation/move.h"
 #include "../representation/board.h"
 
@@ -18,27 +21,43 @@ public:
     struct Entry
     {
         unsigned long long zobrist;
+        Score value; // Mate scores are relative to this position, see scoreToTT()
+        Move bestMove;
+        int16_t staticEval;
         char depth;
-        int value;
         EvalType evalType;
-        Move bestMove;
+        uint8_t generation; // Search that stored the entry, see newSearch()
     };
 
 private:
-    Entry *table;
-    
+    // The search threads share the table without locking, so an entry is kept as three words that are
+    // each read and written atomically, with the key stored xored with the other two (lockless hashing).
+    // A read that mixes the words of two different stores gets a key that matches neither and misses.
+    struct Slot
+    {
+        std::atomic<uint64_t> key;
+        std::atomic<uint64_t> data[2];
+    };
+
+    Slot *table;
+    uint8_t generation = 0;
+
+    Entry read(int index);
+    void write(int index, const Entry &entry);
 
 public:
     TranspositionTable(int size);
     ~TranspositionTable();
 
-    int used = 0;
+    std::atomic<int> used{0}; // Shared by all search threads
     int size;
 
-    void store(unsigned long long zobrist, int depth, int value, Move bestMove, EvalType evalType);
-    int probe(unsigned long long zobrist, int depth, int alpha, int beta);
+    void store(unsigned long long zobrist, int depth, Score value, Move bestMove, EvalType evalType, int ply,
+               Score staticEval);
+    bool lookup(unsigned long long zobrist, Entry &entry, int ply);
     Move getMove(unsigned long long zobrist);
     void clear();
+    void newSearch() { generation++; } // Called when a search starts
 
     int getSize() { return size; }
     int getUsed();
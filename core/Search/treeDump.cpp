@@ -0,0 +1,117 @@
+#ifdef TREE_DUMP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "treeDump.h"
+
+using namespace std;
+
+// clang-format off
+#define TREE_BUFFER_RECORDS (1 << 16) // Ring buffer of each search thread, 1.5 MB
+#define TREE_CHUNK_RECORDS  (1 << 12) // The writer is woken every time this many have been added
+// clang-format on
+
+// Only the search thread that owns a buffer moves its head, and only the writer moves its tail.
+// A search thread waits when its ring is full, so no record is ever dropped.
+struct TreeBuffer
+{
+    TreeRecord records[TREE_BUFFER_RECORDS];
+    atomic<size_t> head{0}; // Records added
+    atomic<size_t> tail{0}; // Records written to the file
+};
+
+vector<unique_ptr<TreeBuffer>> treeBuffers;
+ofstream treeFile;
+thread treeWriter;
+mutex treeWriterMutex;
+condition_variable treeWriterSignal;
+atomic<bool> treeWriterDone(false);
+
+void drainBuffer(TreeBuffer &buffer)
+{
+    size_t head = buffer.head.load(memory_order_acquire);
+    size_t tail = buffer.tail.load(memory_order_relaxed);
+    while (tail < head)
+    {
+        size_t start = tail % TREE_BUFFER_RECORDS;
+        size_t count = min(head - tail, (size_t)TREE_BUFFER_RECORDS - start);
+        treeFile.write((const char *)&buffer.records[start], count * sizeof(TreeRecord));
+        tail += count;
+    }
+    buffer.tail.store(tail, memory_order_release);
+}
+
+// Runs for the length of a search, the search threads never touch the file themselves
+void writeTree()
+{
+    while (true)
+    {
+        // Read before draining, everything added before the search finished is then written
+        bool done = treeWriterDone.load(memory_order_acquire);
+        for (auto &buffer : treeBuffers)
+        {
+            drainBuffer(*buffer);
+        }
+        if (done)
+        {
+            break;
+        }
+
+        unique_lock<mutex> lock(treeWriterMutex);
+        treeWriterSignal.wait_for(lock, chrono::milliseconds(5));
+    }
+    treeFile.flush();
+}
+
+void treeDumpStart(int threadCount)
+{
+    // One file for the whole session, every search is appended to it
+    if (!treeFile.is_open())
+    {
+        treeFile.open(TREE_DUMP_FILE, ios::binary | ios::trunc);
+        uint32_t header[3] = {TREE_DUMP_MAGIC, TREE_DUMP_VERSION, sizeof(TreeRecord)};
+        treeFile.write((const char *)header, sizeof(header));
+    }
+
+    while ((int)treeBuffers.size() < threadCount)
+    {
+        treeBuffers.push_back(make_unique<TreeBuffer>());
+    }
+
+    treeWriterDone = false;
+    treeWriter = thread(writeTree);
+}
+
+void treeDumpFinish()
+{
+    treeWriterDone.store(true, memory_order_release);
+    treeWriterSignal.notify_one();
+    treeWriter.join();
+}
+
+void treeDumpRecord(int threadId, const TreeRecord &record)
+{
+    TreeBuffer &buffer = *treeBuffers[threadId];
+    size_t head = buffer.head.load(memory_order_relaxed);
+    while (head - buffer.tail.load(memory_order_acquire) >= TREE_BUFFER_RECORDS)
+    {
+        treeWriterSignal.notify_one();
+        this_thread::yield();
+    }
+
+    buffer.records[head % TREE_BUFFER_RECORDS] = record;
+    buffer.head.store(head + 1, memory_order_release);
+    if ((head + 1) % TREE_CHUNK_RECORDS == 0)
+    {
+        treeWriterSignal.notify_one();
+    }
+}
+
+#endif
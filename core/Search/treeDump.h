@@ -0,0 +1,103 @@
+#ifndef TREE_DUMP_H
+#define TREE_DUMP_H
+
+#include <cstdint>
+
+#include "score.h"
+#include "../representation/board.h"
+#include "../representation/move.h"
+
+// Search tree log for tuning the pruning, compiled in with -DTREE_DUMP and read with utils/treeStats.py.
+// Every visited node and every move pruned without being searched becomes one record in TREE_DUMP_FILE.
+// Without the define the macros below expand to nothing, so the search is exactly the same code.
+
+// clang-format off
+#define TREE_DUMP_FILE     "tree.bin"
+#define TREE_DUMP_MAGIC    0x44525450 // "PTRD", followed by the version and the record size
+#define TREE_DUMP_VERSION  1
+#define TREE_NO_EVAL       INT16_MIN  // Static eval of a node that ended before evaluating
+// clang-format on
+
+enum TreeNodeType : uint8_t
+{
+    TreePV,
+    TreeNonPV,
+    TreeQSearch
+};
+
+// How a node ended, or for a move record why the move was skipped
+enum TreeReason : uint8_t
+{
+    TreeSearched,     // All moves searched, the result is a bound or exact score
+    TreeBetaCutoff,
+    TreeTTCutoff,
+    TreeMateDistance,
+    TreeFutility,
+    TreeRazoring,
+    TreeProbCut,
+    TreeMultiCut,
+    TreeStandPat,
+    TreeNoMoves,      // Mate or stalemate
+    TreeLateMove,     // Move records from here on
+    TreeHistory,
+    TreeSeeQuiet,
+    TreeDelta,
+    TreeSeeCapture
+};
+
+// 24 bytes, the reader unpacks the same layout
+struct TreeRecord
+{
+    int32_t alpha; // Window the node was entered with
+    int32_t beta;
+    int32_t result;
+    uint32_t move; // Move into the node, or the pruned move
+    int16_t staticEval;
+    uint8_t ply;
+    int8_t depth;
+    TreeNodeType nodeType;
+    TreeReason reason;
+    uint8_t thread;
+    uint8_t padding;
+};
+static_assert(sizeof(TreeRecord) == 24, "tree records are read back by utils/treeStats.py");
+
+inline Move lastMove(Board *board)
+{
+    return board->ply ? board->pastMoves[board->ply - 1] : 0;
+}
+
+#ifdef TREE_DUMP
+
+extern void treeDumpStart(int threadCount); // Before the search threads start
+extern void treeDumpFinish();               // After they have all stopped, writes out the rest
+extern void treeDumpRecord(int threadId, const TreeRecord &record);
+
+#define TREE_DUMP_START(threadCount) treeDumpStart(threadCount)
+#define TREE_DUMP_FINISH() treeDumpFinish()
+
+// Saves the window and the move into the node for the TREE_DUMP_NODE calls below it
+#define TREE_DUMP_ENTER(board, alpha, beta) \
+    Score dumpAlpha = alpha;                \
+    Score dumpBeta = beta;                  \
+    Move dumpMove = lastMove(board)
+
+#define TREE_DUMP_NODE(thread, ply, depth, eval, result, nodeType, reason)                                   \
+    treeDumpRecord(thread, {dumpAlpha, dumpBeta, (int32_t)(result), dumpMove, (int16_t)(eval), (uint8_t)(ply), \
+                            (int8_t)(depth), nodeType, reason, (uint8_t)(thread), 0})
+
+#define TREE_DUMP_MOVE(thread, ply, depth, move, eval, nodeType, reason)                                 \
+    treeDumpRecord(thread, {dumpAlpha, dumpBeta, 0, move, (int16_t)(eval), (uint8_t)(ply), (int8_t)(depth), \
+                            nodeType, reason, (uint8_t)(thread), 0})
+
+#else
+
+#define TREE_DUMP_START(threadCount)
+#define TREE_DUMP_FINISH()
+#define TREE_DUMP_ENTER(board, alpha, beta)
+#define TREE_DUMP_NODE(thread, ply, depth, eval, result, nodeType, reason)
+#define TREE_DUMP_MOVE(thread, ply, depth, move, eval, nodeType, reason)
+
+#endif
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <sstream>
+
+using namespace std;
+
+// clang-format off
+#define BENCH_DEPTH   9  // Default depth of "bench"
+#define BENCH_THREADS 1
+#define BENCH_HASH    16 // MB
+// clang-format on
+
+// Handles "bench [depth] [threads] [hash]", also run by "./Pioneer bench ..." from the command line.
+// Searches a fixed set of positions from a cleared state and prints the total nodes, time and nps.
+// With one thread the node total only changes when the search does, so it serves as a signature.
+extern void parseBench(istringstream &parser);
+
+#endif
@@ -4,22 +4,48 @@ Will Garrison
 TODO: Ensure it is uci compliant
 */
 
-#include "uci.h" // uci.cpp will handle the communication between the user and the engine
+#include "uci.h"   // uci.cpp will handle the communication between the user and the engine
+#include "bench.h"
 
 using namespace std;
 
-int main()
+int main(int argc, char *argv[])
 {
 
     setup(); // Setup the board
 
+    // "./Pioneer bench [depth] [threads] [hash]" runs the bench and exits
+    if (argc > 1 && std::string(argv[1]) == "bench")
+    {
+        std::string arguments;
+        for (int i = 2; i < argc; i++)
+        {
+            arguments += std::string(argv[i]) + " ";
+        }
+        istringstream parser(arguments);
+        parseBench(parser);
+        closeOutput();
+        return 0;
+    }
+
     std::cout << "Welcome the Pioneer V0.3, a chess engine by Will Garrison\n";
 
     std::string input;
     while (true)
     {
-        // Get the input from the user
-        getline(std::cin, input);
+        // Get the input from the user, end of input stops a running search
+        if (!getline(std::cin, input))
+        {
+            // Nobody is left to send "stop" or "ponderhit". A ponder search goes on as if the move was played
+            // and an infinite one has nothing else to end it, anything with a limit is let finish.
+            ponderSearch = false;
+            if (infiniteSearch)
+            {
+                stopSearch = true;
+            }
+            waitForSearch();
+            break;
+        }
 
         // string parser
         istringstream parser(input);
@@ -28,7 +54,18 @@ int main()
         // Begin parsing the input
         if (input == "quit")
         {
-            break; // quit the program
+            parseStop(parser); // stop and join the search thread
+            break;             // quit the program
+        }
+
+        else if (input == "stop")
+        {
+            parseStop(parser);
+        }
+
+        else if (input == "ponderhit")
+        {
+            parsePonderHit(parser);
         }
 
         else if (input == "uci")
@@ -60,6 +97,10 @@ int main()
         {
             parseDebug(parser);
         }
+        else if (input == "stats")
+        {
+            parseStats(parser);
+        }
         else if (input == "d")
         {
             parseDisplay(parser);
@@ -80,12 +121,22 @@ int main()
         {
             parseClearTT(parser);
         }
+        else if (input == "bench")
+        {
+            parseBench(parser);
+        }
+        else if (input == "setoption")
+        {
+            parseSetOption(parser);
+        }
         else
         {
-            cout << "Unknown command: " << input << endl;
+            sendLine("Unknown command: " + input);
         }
 
         // Clear the input
         input.clear();
     }
+
+    closeOutput();
 }
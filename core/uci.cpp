@@ -3,9 +3,13 @@
 #include <iostream>
 #include <sstream>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
 
 #include "uci.h"
 #include "search/evaluate.h"
+#include "search/mate.h"
 #include "search/moveOrder.h"
 #include "representation/bitboard.h"
 #include "movegen/movegen.h"
@@ -14,7 +18,70 @@
 
 using namespace std;
 
+#define MATE_FALLBACK_DEPTH 6 // Search for a move to play when "go mate" finds no mate
+
 Board board;
+thread searchThread; // Runs the "go" command so the input loop stays responsive
+
+deque<string> outputQueue;
+mutex outputMutex;
+condition_variable outputSignal; // Wakes the writer for new lines and flushOutput() once they are written
+bool outputWriting = false;
+bool outputClosed = false;
+thread outputThread;
+
+void writeOutput()
+{
+    unique_lock<mutex> lock(outputMutex);
+    while (true)
+    {
+        outputSignal.wait(lock, [] { return !outputQueue.empty() || outputClosed; });
+        if (outputQueue.empty())
+        {
+            break;
+        }
+
+        // Write the whole batch without holding the queue, so sendLine() never waits on stdout
+        deque<string> lines;
+        lines.swap(outputQueue);
+        outputWriting = true;
+        lock.unlock();
+        for (const string &line : lines)
+        {
+            cout << line << "\n";
+        }
+        cout.flush();
+        lock.lock();
+        outputWriting = false;
+        outputSignal.notify_all();
+    }
+}
+
+void sendLine(const string &line)
+{
+    lock_guard<mutex> lock(outputMutex);
+    outputQueue.push_back(line);
+    outputSignal.notify_all();
+}
+
+void flushOutput()
+{
+    unique_lock<mutex> lock(outputMutex);
+    outputSignal.wait(lock, [] { return outputQueue.empty() && !outputWriting; });
+}
+
+void closeOutput()
+{
+    {
+        lock_guard<mutex> lock(outputMutex);
+        outputClosed = true;
+        outputSignal.notify_all();
+    }
+    if (outputThread.joinable())
+    {
+        outputThread.join();
+    }
+}
 
 void setup()
 {
@@ -27,6 +94,9 @@ void setup()
     precomputeRookMoves();
     precomputeBishopMoves();
 
+    initSearch();
+    setThreadCount(1);
+    outputThread = thread(writeOutput);
 
     board = Board(); // Initialize the board after the magic bitboards are set up
     board.loadFEN(startFen, true, true, true, true, true, -1);
@@ -103,6 +173,20 @@ string moveToString(Move move)
     return moveString;
 }
 
+// UCI score, "cp <centipawns>" or "mate <moves>" with a negative count when we are getting mated
+string scoreToString(Score score)
+{
+    if (score > MATE_BOUND)
+    {
+        return "mate " + to_string((POSINF - score + 1) / 2);
+    }
+    if (score < -MATE_BOUND)
+    {
+        return "mate " + to_string(-(POSINF + score) / 2);
+    }
+    return "cp " + to_string(score);
+}
+
 char pieceToChar(Piece piece)
 {
     switch (piece)
@@ -140,23 +224,56 @@ char pieceToChar(Piece piece)
 
 void parseUCI(istringstream &parser)
 {
-    cout << "id name Pioneer V0.3.2\n";
-    cout << "id author Will Garrison\n";
-    cout << "uciok\n";
+    sendLine("id name Pioneer V0.3.2");
+    sendLine("id author Will Garrison");
+    sendLine("option name Threads type spin default 1 min 1 max 256");
+    sendLine("option name Hash type spin default 16 min 1 max " + to_string(MAX_HASH_MB));
+    sendLine("option name Ponder type check default false");
+    sendLine("option name MultiPV type spin default 1 min 1 max 256");
+    sendLine("option name ProbCutMargin type spin default 200 min 0 max 1000");
+    sendLine("option name Move Overhead type spin default 50 min 0 max 5000");
+    sendLine("uciok");
 }
 
 void parseIsReady(istringstream &parser)
 {
-
-    cout << "readyok" << endl;
+    sendLine("readyok");
 }
 
 void parseNewGame(istringstream &parser)
 {
+    waitForSearch();
+    clearTTSearch();
+    clearSearchHistory();
+    clearMateTable();
+}
+
+// Also waits for the search's output, so whatever the caller prints comes after it
+void waitForSearch()
+{
+    if (searchThread.joinable())
+    {
+        searchThread.join();
+    }
+    flushOutput();
+}
+
+void parseStop(istringstream &parser)
+{
+    stopSearch = true;
+    waitForSearch();
+}
+
+// The opponent played the move we were pondering on, keep the search going with the clock running
+void parsePonderHit(istringstream &parser)
+{
+    ponderSearch = false;
 }
 
 void parsePosition(istringstream &parser)
 {
+    waitForSearch();
+
     string input;
     parser >> input;
 
@@ -222,16 +339,47 @@ void parsePosition(istringstream &parser)
     }
 }
 
+// Body of the search thread, the board is not touched by the input loop until it is joined
+void runSearch(SearchLimits limits)
+{
+    Move bestMove;
+    Move ponderMove;
+    if (limits.mate)
+    {
+        bestMove = solveMate(&board, limits, ponderMove);
+
+        // No mate, or stopped before one was proven, but the GUI still needs a legal move.
+        // After a "stop" the search returns right away with the first move in its ordering.
+        if (!bestMove)
+        {
+            SearchLimits fallback;
+            fallback.depth = MATE_FALLBACK_DEPTH;
+            bestMove = startSearch(&board, fallback);
+            ponderMove = getPonderMove(&board, bestMove);
+        }
+    }
+    else
+    {
+        bestMove = startSearch(&board, limits);
+        ponderMove = getPonderMove(&board, bestMove);
+    }
+
+    string line = "bestmove " + (bestMove ? moveToString(bestMove) : "0000");
+    if (ponderMove)
+    {
+        line += " ponder " + moveToString(ponderMove);
+    }
+    sendLine(line);
+}
+
 // Starts a search by the engine based off the specified parameters
-// TODO: Implement wtime and btime
 void parseGo(istringstream &parser)
 {
-    bool perft = false;             // Is a perft search
-    unsigned int depthValue = MAX_DEPTH;  // Targeted depth of the search
-    unsigned int nodesCount = 0;    // Max number of nodes to search
-    unsigned int moveTimeValue = 0; // Max time to search in milliseconds
-    unsigned int wtime = 0;         // White time
-    unsigned int btime = 0;         // Black time
+    bool perft = false;   // Is a perft search
+    SearchLimits limits;  // Limits for a normal search
+    limits.depth = MAX_DEPTH;
+
+    waitForSearch();
 
     while (parser)
     {
@@ -245,40 +393,73 @@ void parseGo(istringstream &parser)
             // Set depth of perft search
             string depthInput;
             parser >> depthInput;
-            depthValue = stoi(depthInput);
+            limits.depth = stoi(depthInput);
         }
         else if (option == "depth")
         {
             // User specified depth
             string depthInput;
             parser >> depthInput;
-            depthValue = stoi(depthInput);
+            limits.depth = stoi(depthInput);
         }
         else if (option == "nodes")
         {
             // User specified number of nodes
             string nodesInput;
             parser >> nodesInput;
-            nodesCount = stoi(nodesInput);
+            limits.nodes = stoi(nodesInput);
         }
         else if (option == "movetime")
         {
             // User specified time to search
             string moveTimeInput;
             parser >> moveTimeInput;
-            moveTimeValue = stoi(moveTimeInput);
+            limits.moveTime = stoi(moveTimeInput);
+        }
+        else if (option == "ponder")
+        {
+            limits.ponder = true;
+        }
+        else if (option == "infinite")
+        {
+            limits.infinite = true;
         }
         else if (option == "wtime")
         {
+            // Some GUIs send a negative time when the flag is about to fall
             string wtimeInput;
             parser >> wtimeInput;
-            wtime = stoi(wtimeInput);
+            limits.wtime = max(stoi(wtimeInput), 1);
         }
         else if (option == "btime")
         {
             string btimeInput;
             parser >> btimeInput;
-            btime = stoi(btimeInput);
+            limits.btime = max(stoi(btimeInput), 1);
+        }
+        else if (option == "winc")
+        {
+            string wincInput;
+            parser >> wincInput;
+            limits.winc = max(stoi(wincInput), 0);
+        }
+        else if (option == "binc")
+        {
+            string bincInput;
+            parser >> bincInput;
+            limits.binc = max(stoi(bincInput), 0);
+        }
+        else if (option == "movestogo")
+        {
+            string movesToGoInput;
+            parser >> movesToGoInput;
+            limits.movesToGo = max(stoi(movesToGoInput), 0);
+        }
+        else if (option == "mate")
+        {
+            string mateInput;
+            parser >> mateInput;
+            limits.mate = max(stoi(mateInput), 0);
         }
     }
     if (perft)
@@ -287,30 +468,114 @@ void parseGo(istringstream &parser)
         cout << "\n";
 
         auto start = chrono::high_resolution_clock::now();
-        unsigned long long perft = startPerft(board, depthValue);
+        unsigned long long perft = startPerft(board, limits.depth);
         auto stop = chrono::high_resolution_clock::now();
 
-        cout << "Perft search to depth: " << depthValue << "\n"
+        cout << "Perft search to depth: " << limits.depth << "\n"
              << "Took " << chrono::duration_cast<chrono::milliseconds>(stop - start).count() << "ms\n";
         cout << "Nodes: " << perft << "\n";
     }
     else
     {
-        // Normal search
-        auto start = chrono::high_resolution_clock::now();
-        Move bestMove = startSearch(&board, depthValue, moveTimeValue, nodesCount, wtime, btime);
-        auto stop = chrono::high_resolution_clock::now();
-        cout << "bestmove " << moveToString(bestMove) << endl;
+        // Normal search, runs on its own thread until it finishes or "stop" is received
+        // The flags are set here so a "stop" or "ponderhit" right after "go" can't be lost
+        stopSearch = false;
+        ponderSearch = limits.ponder;
+        infiniteSearch = limits.infinite;
+        searchThread = thread(runSearch, limits);
+    }
+}
+
+// Reads the value of a spin option, clamped to the range "uci" advertises for it.
+// Anything that isn't a number is reported and leaves the option as it was.
+bool parseSpin(const string &name, const string &value, int low, int high, int &result)
+{
+    long long number;
+    istringstream parser(value);
+    if (!(parser >> number))
+    {
+        sendLine("info string invalid value for " + name + ": " + value);
+        return false;
+    }
+    number = max(number, (long long)low);
+    result = (int)min(number, (long long)high);
+    return true;
+}
+
+// Handles "setoption name <name> value <value>", option names may contain spaces
+void parseSetOption(istringstream &parser)
+{
+    waitForSearch();
+
+    string input;
+    string name;
+    string value;
+
+    parser >> input; // "name"
+    while (parser >> input && input != "value")
+    {
+        name += (name.empty() ? "" : " ") + input;
+    }
+    while (parser >> input)
+    {
+        value += (value.empty() ? "" : " ") + input;
+    }
+
+    int number;
+    if (name == "Threads")
+    {
+        if (parseSpin(name, value, 1, 256, number))
+        {
+            setThreadCount(number);
+        }
+    }
+    else if (name == "Hash")
+    {
+        if (parseSpin(name, value, 1, MAX_HASH_MB, number))
+        {
+            setHashSize(number);
+        }
+    }
+    else if (name == "MultiPV")
+    {
+        if (parseSpin(name, value, 1, 256, number))
+        {
+            setMultiPV(number);
+        }
+    }
+    else if (name == "ProbCutMargin")
+    {
+        if (parseSpin(name, value, 0, 1000, number))
+        {
+            setProbCutMargin(number);
+        }
+    }
+    else if (name == "Move Overhead")
+    {
+        if (parseSpin(name, value, 0, 5000, number))
+        {
+            timeManager.moveOverhead = number;
+        }
+    }
+    else if (name == "Ponder")
+    {
+        // Nothing to set up, the GUI decides when to send "go ponder"
+    }
+    else
+    {
+        sendLine("info string unknown option " + name);
     }
 }
 
 void parseEval(istringstream &parser)
 {
+    waitForSearch();
     cout << "Eval: " << evaluate(&board) << "\n";
 }
 
 void parseMakeMove(istringstream &parser)
 {
+    waitForSearch();
     string input;
     parser >> input;
     Move move = stringToMove(input, board);
@@ -319,11 +584,15 @@ void parseMakeMove(istringstream &parser)
 
 void parseClearTT(istringstream &parser)
 {
+    waitForSearch();
     clearTTSearch();
+    clearSearchHistory();
+    clearMateTable();
 }
 
 void parseUndoMove(istringstream &parser)
 {
+    waitForSearch();
     board.undoMove();
 }
 
@@ -331,6 +600,15 @@ void parseDebug(istringstream &parser)
 {
     string option;
     parser >> option;
+
+    // UCI allows switching debug mode during a search
+    if (option == "on" || option == "off")
+    {
+        debugMode = option == "on";
+        return;
+    }
+
+    waitForSearch();
     if (option == "print")
     {
         string input;
@@ -357,8 +635,15 @@ void parseDebug(istringstream &parser)
     }
 }
 
+void parseStats(istringstream &parser)
+{
+    waitForSearch();
+    printSearchStats();
+}
+
 void parseDisplay(istringstream &parser)
 {
+    waitForSearch();
     board.printBoard();
     cout << "\n";
     board.printFEN();
@@ -2,6 +2,7 @@
 #define UCI_H
 
 #include <iostream>
+#include <mutex>
 #include <sstream>
 
 #include "representation/board.h"
@@ -16,9 +17,18 @@ using namespace std;
 #define max(a, b) ((a > b) ? a : b)
 
 
+// Output of the search goes through a queue that its own thread writes to stdout,
+// so a GUI that is slow to read can't stall the search. Anything that can be printed
+// while a search runs has to go through it too, only the debugging commands that
+// wait for the search first write to cout directly.
+extern void sendLine(const string &line); // Queues a line, the newline is added by the writer
+extern void flushOutput();                // Blocks until everything queued has been written
+extern void closeOutput();                // Writes what is left and stops the writer, before exiting
+extern Board board; // Position the commands work on
 
 extern Move stringToMove(string moveString, Board board);
 extern string moveToString(Move move);
+extern string scoreToString(Score score);
 extern char pieceToChar(Piece piece);
 extern void parseUCI(istringstream &parser);      // Handles the "UCI" command
 extern void parseIsReady(istringstream &parser);  // Handles the "isready" command
@@ -27,10 +37,15 @@ extern void parsePosition(istringstream &parser); // Handles the "position" comm
 extern void parseGo(istringstream &parser);       // Handles the "go" command
 extern void parseEval(istringstream &parser);      // Handles the "eval" command
 extern void parseDebug(istringstream &parser);    // Handles the "debug" command
+extern void parseStats(istringstream &parser);    // Handles the "stats" command
 extern void parseDisplay(istringstream &parser);  // Handles the "d" command
 extern void parseMakeMove(istringstream &parser); // Handles the "makemove" command
 extern void parseUndoMove(istringstream &parser); // Handles the "undomove" command
 extern void parseClearTT(istringstream &parser);     // Handles the "clearTT" command
+extern void parseSetOption(istringstream &parser); // Handles the "setoption" command
+extern void parseStop(istringstream &parser);      // Handles the "stop" command
+extern void parsePonderHit(istringstream &parser); // Handles the "ponderhit" command
+extern void waitForSearch();                      // Blocks until the search thread has finished
 extern void setup();                              // set up the uci and other relevant variables
 
 
@@ -0,0 +1,83 @@
+import struct
+import sys
+from collections import Counter
+
+# Reads the search tree log written by an engine built with -DTREE_DUMP (see core/Search/treeDump.h)
+# and prints histograms of what happened at each depth.
+
+MAGIC = 0x44525450
+VERSION = 1
+RECORD = struct.Struct("<iiiIhBbBBBx")
+
+nodeTypes = ["PV", "NonPV", "QSearch"]
+reasons = [
+    "searched",
+    "beta cutoff",
+    "tt cutoff",
+    "mate distance",
+    "futility",
+    "razoring",
+    "probcut",
+    "multicut",
+    "stand pat",
+    "no moves",
+    "late move",
+    "history",
+    "see quiet",
+    "delta",
+    "see capture",
+]
+FIRST_MOVE_REASON = reasons.index("late move")
+
+
+def printTable(title: str, counts: Counter, columns: list, names: list):
+    depths = sorted({depth for depth, _ in counts})
+    used = [column for column in columns if any(counts[depth, column] for depth in depths)]
+    width = max([len(names[column]) for column in used] + [9]) + 2
+
+    print(f"\n{title}")
+    print("depth" + "".join(names[column].rjust(width) for column in used))
+    for depth in depths:
+        print(str(depth).rjust(5) + "".join(str(counts[depth, column]).rjust(width) for column in used))
+
+
+def treeStats(path: str):
+    with open(path, "rb") as file:
+        data = file.read()
+
+    magic, version, size = struct.unpack_from("<III", data)
+    if magic != MAGIC or version != VERSION or size != RECORD.size:
+        print(f"{path} is not a version {VERSION} tree log")
+        sys.exit(1)
+
+    byType = Counter()
+    byReason = Counter()
+    bounds = Counter()
+    threads = Counter()
+    records = 0
+    for alpha, beta, result, move, eval, ply, depth, nodeType, reason, thread, in RECORD.iter_unpack(data[12:]):
+        records += 1
+        threads[thread] += 1
+        byReason[depth, reason] += 1
+        if reason >= FIRST_MOVE_REASON:
+            continue
+
+        byType[depth, nodeType] += 1
+        if reason == reasons.index("searched"):
+            bound = 0 if result <= alpha else 2 if result >= beta else 1
+            bounds[depth, bound] += 1
+
+    print(f"{records} records from {len(threads)} threads")
+    printTable("Nodes by depth and type", byType, range(len(nodeTypes)), nodeTypes)
+    printTable("Node results and pruned moves by depth and reason", byReason, range(len(reasons)), reasons)
+    printTable("Fully searched nodes by depth and result", bounds, range(3), ["fail low", "exact", "fail high"])
+
+
+if __name__ == "__main__":
+
+    args = sys.argv[1:]
+    if len(args) > 1:
+        print("Usage: python treeStats.py [tree.bin]")
+        sys.exit(1)
+
+    treeStats(args[0] if args else "tree.bin")